@@ -0,0 +1,58 @@
+#include "laby_benchs.c"
+#include <stdio.h>
+#include <unistd.h>
+
+char *bench_only = NULL;
+const char *bench_current = NULL;
+FILE *bench_json = NULL;
+int bench_json_records = 0;
+
+int terminal_window_height = 0;
+int terminal_window_width = 0;
+
+int
+main (int argc, char *argv[])
+{
+  int p;
+  while ((p = getopt (argc, argv, "j:")) != -1)
+    {
+      if (p != 'j')
+        {
+          fprintf (stderr, "Usage: run_benchs [-j results.json] [name]\n");
+          return 1;
+        }
+      bench_json = fopen (optarg, "w");
+      if (bench_json == NULL)
+        {
+          perror (optarg);
+          return 1;
+        }
+      fprintf (bench_json, "[");
+    }
+  if (optind < argc)
+    bench_only = argv[optind];
+
+  printf ("Run benchmarks...\n");
+  mb_run_bench (laby_suite_bench);
+  mb_run_bench (laby_generate_bench);
+  mb_run_bench (laby_generate_wide_bench);
+  mb_run_bench (laby_generate_versions_bench);
+  mb_run_bench (laby_generators_bench);
+  mb_run_bench (laby_generate_parallel_bench);
+  mb_run_bench (laby_generate_chunks_bench);
+  mb_run_bench (laby_generate_batch_bench);
+  mb_run_bench (laby_bfs_bench);
+  mb_run_bench (laby_solver_bench);
+  mb_run_bench (laby_stats_bench);
+  mb_run_bench (render_laby_bench);
+  mb_run_bench (laby_bulk_ops_bench);
+  mb_run_bench (laby_layouts_bench);
+  mb_run_bench (laby_file_bench);
+  mb_run_bench (laby_stream_bench);
+  if (bench_json)
+    {
+      fprintf (bench_json, "\n]\n");
+      fclose (bench_json);
+    }
+  return 0;
+}
@@ -0,0 +1,482 @@
+#include "game.h"
+#include "lcg.h"
+#include "laby.h"
+#include "laby_bfs.h"
+#include "laby_gen.h"
+#include "laby_solver.h"
+#include "laby_stats.h"
+#include "minibench.h"
+#include "render.h"
+#include "u8.h"
+#include <fcntl.h>
+
+/**
+ * The main operations of the game over the matrix of sizes and seeds, which
+ * is tracked across releases: generation, visibility on every step, and
+ * drawing of the viewport. The terminal output goes to /dev/null.
+ */
+static void
+laby_suite_bench ()
+{
+  int sizes[] = { 100, 1000, 3000 };
+  int generate_runs[] = { 50, 10, 5 };
+  lcg seeds[] = { 1, 1904, 65537 };
+  int dev_null = open ("/dev/null", O_WRONLY);
+  for (int i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    for (int j = 0; j < sizeof (seeds) / sizeof (seeds[0]); j++)
+      {
+        int n = sizes[i];
+        char label[40];
+        sprintf (label, "generate %dx%d seed %lu", n, n,
+                 (unsigned long)seeds[j]);
+        mb_measure_runs (label, 1, generate_runs[i], {
+          lcg seed = seeds[j];
+          Laby lab;
+          laby_generate (&lab, n, n, &seed);
+          laby_free (&lab);
+        });
+
+        lcg seed = seeds[j];
+        Laby lab;
+        laby_generate (&lab, n, n, &seed);
+        laby_mark_whole_as_known (&lab);
+        sprintf (label, "visible rooms %dx%d seed %lu", n, n,
+                 (unsigned long)seeds[j]);
+        mb_measure_runs (label, 100, 10000, {
+          int r = lcg_rand (&seed) % n;
+          int c = lcg_rand (&seed) % n;
+          laby_mark_visible_rooms (&lab, r, c, 2);
+        });
+
+        sprintf (label, "render %dx%d seed %lu", n, n,
+                 (unsigned long)seeds[j]);
+        mb_measure_runs (label, 10, 200, {
+          Render render = DEFAULT_RENDER;
+          render_laby (&render, &lab, DLM_MAP);
+          u8_buffer_free (&render.buf);
+        });
+
+        Render render = DEFAULT_RENDER;
+        render_laby (&render, &lab, DLM_MAP);
+        sprintf (label, "write %dx%d seed %lu", n, n,
+                 (unsigned long)seeds[j]);
+        mb_measure_runs (label, 10, 200,
+                         u8_buffer_write (dev_null, &render.buf, 0, 0,
+                                          render.game_screen_height,
+                                          render.game_screen_width));
+        u8_buffer_free (&render.buf);
+        laby_free (&lab);
+      }
+  close (dev_null);
+}
+
+static void
+laby_generate_bench ()
+{
+  int sizes[] = { 100, 300, 1000 };
+  for (int i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    {
+      int n = sizes[i];
+      char label[40];
+      sprintf (label, "%dx%d", n, n);
+      mb_measure (label, 3, {
+        lcg seed = 1904;
+        Laby lab;
+        laby_generate (&lab, n, n, &seed);
+        laby_free (&lab);
+      });
+    }
+}
+
+/* The time per room should not depend on the width */
+static void
+laby_generate_wide_bench ()
+{
+  int rows = 100;
+  int sizes[] = { 1000, 10000, 100000, 1000000 };
+  for (int i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    {
+      int n = sizes[i];
+      char label[40];
+      sprintf (label, "%dx%d", rows, n);
+      double start = mb_now ();
+      mb_measure (label, 3, {
+        lcg seed = 1904;
+        Laby lab;
+        laby_generate (&lab, rows, n, &seed);
+        laby_free (&lab);
+      });
+      printf ("   %-40s %14.3f ns\n", "  per room",
+              (mb_now () - start) / 3 / ((double)rows * n) * 1e9);
+    }
+}
+
+static void
+laby_generate_versions_bench ()
+{
+  int n = 2000;
+  enum laby_eller_version versions[] = { LEV_1, LEV_2 };
+  for (int i = 0; i < sizeof (versions) / sizeof (versions[0]); i++)
+    {
+      char label[40];
+      sprintf (label, "%dx%d, version %d", n, n, versions[i]);
+      double start = mb_now ();
+      mb_measure (label, 3, {
+        lcg seed = 1904;
+        Laby lab;
+        laby_init_empty (&lab, n, n);
+        laby_generate_eller_version (&lab, &seed, versions[i]);
+        laby_free (&lab);
+      });
+      printf ("   %-40s %14.3f M rooms/s\n", "  speed",
+              3.0 * n * n / (mb_now () - start) / 1e6);
+    }
+}
+
+static void
+laby_generators_bench ()
+{
+  int sizes[] = { 1000, 4000, 16000 };
+  for (int i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    for (int j = 0; j < laby_generators_count; j++)
+      {
+        int n = sizes[i];
+        char label[40];
+        sprintf (label, "%s %dx%d", laby_generators[j].name, n, n);
+        mb_measure_memory (label, {
+          lcg seed = 1904;
+          Laby lab;
+          laby_generators[j].generate (&lab, n, n, &seed);
+        });
+      }
+}
+
+static void
+laby_generate_parallel_bench ()
+{
+  int n = 4000;
+  int threads[] = { 1, 2, 4, 8 };
+  for (int i = 0; i < sizeof (threads) / sizeof (threads[0]); i++)
+    {
+      char label[40];
+      sprintf (label, "%dx%d on %d threads", n, n, threads[i]);
+      mb_measure (label, 3, {
+        lcg seed = 1904;
+        Laby lab;
+        laby_init_empty (&lab, n, n);
+        laby_generate_parallel (&lab, &seed, threads[i]);
+        laby_free (&lab);
+      });
+    }
+}
+
+static void
+laby_generate_batch_bench ()
+{
+  int sizes[] = { 10, 30, 100 };
+  for (int i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    {
+      int n = sizes[i];
+      char label[40];
+      sprintf (label, "%d of %dx%d one by one", LABY_BATCH_LANES, n, n);
+      mb_measure (label, 10, {
+        for (int k = 0; k < LABY_BATCH_LANES; k++)
+          {
+            lcg seed = 1904 + k;
+            Laby lab;
+            laby_generate (&lab, n, n, &seed);
+            laby_free (&lab);
+          }
+      });
+
+      sprintf (label, "%d of %dx%d batch", LABY_BATCH_LANES, n, n);
+      mb_measure (label, 10, {
+        lcg seeds[LABY_BATCH_LANES];
+        for (int k = 0; k < LABY_BATCH_LANES; k++)
+          seeds[k] = 1904 + k;
+        Laby_Batch batch;
+        laby_generate_batch (&batch, n, n, seeds);
+        laby_batch_free (&batch);
+      });
+    }
+}
+
+static void
+laby_generate_chunks_bench ()
+{
+  /* a chunk far from the origin costs the same as the first one */
+  long coords[] = { 0, 1000, 1L << 40 };
+  for (int i = 0; i < sizeof (coords) / sizeof (coords[0]); i++)
+    {
+      char label[40];
+      sprintf (label, "chunk at %ld:%ld", coords[i], coords[i]);
+      mb_measure (label, 100, {
+        Laby lab;
+        laby_generate_chunk (&lab, 1904, coords[i], coords[i]);
+        laby_free (&lab);
+      });
+    }
+}
+
+static void
+laby_stats_bench ()
+{
+  int sizes[] = { 1000, 4000, 10000 };
+  for (int i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    {
+      int n = sizes[i];
+      lcg seed = 1904;
+      Laby lab;
+      laby_generate (&lab, n, n, &seed);
+
+      char label[40];
+      sprintf (label, "%dx%d", n, n);
+      mb_measure (label, 1, {
+        Laby_Stats stats;
+        laby_compute_stats (&lab, &stats);
+      });
+
+      /* the placement of the exit of every new level */
+      int r, c;
+      sprintf (label, "%dx%d exit room", n, n);
+      mb_measure (label, 1,
+                  laby_choose_room_at_percentile (&lab, n / 2, n / 2, 90, 1,
+                                                  &seed, &r, &c));
+      laby_free (&lab);
+    }
+}
+
+static void
+laby_bfs_bench ()
+{
+  int sizes[] = { 1000, 4000, 10000 };
+  for (int i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    {
+      int n = sizes[i];
+      lcg seed = 1904;
+      Laby lab;
+      laby_generate (&lab, n, n, &seed);
+
+      char label[60];
+      Laby_Bfs bfs;
+      sprintf (label, "init %dx%d", n, n);
+      mb_measure (label, 1, laby_bfs_init (&bfs, &lab, 0));
+      sprintf (label, "all rooms of %dx%d", n, n);
+      mb_measure (label, 1, laby_bfs_run (&bfs, 0, 0, -1, -1, -1));
+      sprintf (label, "20 steps in %dx%d", n, n);
+      mb_measure (label, 1000, laby_bfs_run (&bfs, n / 2, n / 2, -1, -1, 20));
+      laby_bfs_free (&bfs);
+
+      laby_bfs_init (&bfs, &lab, 1);
+      sprintf (label, "all rooms of %dx%d with distances", n, n);
+      mb_measure (label, 1, laby_bfs_run (&bfs, 0, 0, -1, -1, -1));
+      laby_bfs_free (&bfs);
+      laby_free (&lab);
+    }
+}
+
+static void
+laby_solver_bench ()
+{
+  int sizes[] = { 1000, 4000 };
+  for (int i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    {
+      int n = sizes[i];
+      lcg seed = 1904;
+      Laby lab;
+      laby_generate (&lab, n, n, &seed);
+
+      char label[60];
+      Laby_Solver solver;
+      sprintf (label, "init %dx%d", n, n);
+      mb_measure (label, 1, laby_solver_init (&solver, &lab));
+      sprintf (label, "corner to corner of %dx%d", n, n);
+      mb_measure (label, 1, laby_solve (&solver, 0, 0, n - 1, n - 1));
+      /* the closed rooms of the last search are taken for the same target */
+      sprintf (label, "corner to corner of %dx%d again", n, n);
+      mb_measure (label, 100, laby_solve (&solver, 0, 0, n - 1, n - 1));
+      sprintf (label, "50 rooms away in %dx%d", n, n);
+      mb_measure (label, 100,
+                  laby_solve (&solver, n / 2, n / 2, n / 2 + 25, n / 2 + 25));
+      laby_solver_free (&solver);
+      laby_free (&lab);
+    }
+}
+
+static void
+render_laby_bench ()
+{
+  int sizes[] = { 30, 100, 300 };
+  for (int i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++)
+    {
+      int n = sizes[i];
+      lcg seed = 1904;
+      Laby lab;
+      laby_generate (&lab, n, n, &seed);
+      laby_mark_whole_as_known (&lab);
+
+      char label[40];
+      sprintf (label, "viewport of %dx%d", n, n);
+      mb_measure (label, 100, {
+        Render render = DEFAULT_RENDER;
+        render_laby (&render, &lab, DLM_MAP);
+        u8_buffer_free (&render.buf);
+      });
+
+      sprintf (label, "whole %dx%d", n, n);
+      mb_measure (label, 3, {
+        Render render = render_create (2, 4, 2 * n, 4 * n);
+        render_laby (&render, &lab, DLM_WHOLE);
+        u8_buffer_free (&render.buf);
+      });
+      laby_free (&lab);
+    }
+}
+
+static void
+laby_bulk_ops_bench ()
+{
+  int n = 4000;
+  Laby lab;
+  laby_init_empty (&lab, n, n);
+  long count = 0;
+
+  mb_measure ("mark known room by room", 3, {
+    for (int r = 0; r < n; r++)
+      for (int c = 0; c < n; c++)
+        laby_mark_as_known_room (&lab, r, c);
+  });
+  mb_measure ("mark known at once", 3, laby_mark_whole_as_known (&lab));
+
+  mb_measure ("count known room by room", 3, {
+    count = 0;
+    for (int r = 0; r < n; r++)
+      for (int c = 0; c < n; c++)
+        count += laby_is_known_room (&lab, r, c);
+  });
+  mb_measure ("count known at once", 3,
+              count = laby_count_rect (&lab, LP_KNOWN, 0, 0, n, n));
+
+  /* the same as on every step of the player */
+  mb_measure ("unmark visible 5x5 room by room", 100000, {
+    for (int r = 1000; r < 1005; r++)
+      for (int c = 1000; c < 1005; c++)
+        laby_set_visibility (&lab, r, c, 0);
+  });
+  mb_measure ("unmark visible 5x5 at once", 100000,
+              laby_fill_rect (&lab, LP_VISIBLE, 1000, 1000, 5, 5, 0));
+
+  laby_free (&lab);
+}
+
+/* Random walls over the whole labyrinth without the generator, which is too
+ * slow for wide labyrinths */
+static void
+add_random_borders (Laby *lab, lcg *seed)
+{
+  for (int r = 0; r < lab->rows; r++)
+    for (int c = 0; c < lab->cols; c++)
+      {
+        int x = lcg_rand (seed);
+        if (x & 1)
+          laby_add_border (lab, r, c, RIGHT_BORDER);
+        if (x & 2)
+          laby_add_border (lab, r, c, BOTTOM_BORDER);
+      }
+}
+
+static void
+laby_layouts_bench ()
+{
+  int rows = 1024;
+  int cols = 16384;
+  enum laby_layout layouts[] = { LL_ROWS, LL_BLOCKS, LL_MORTON };
+  char *names[] = { "rows", "blocks", "morton" };
+  for (int i = 0; i < sizeof (layouts) / sizeof (layouts[0]); i++)
+    {
+      lcg seed = 1904;
+      Laby lab;
+      laby_init (&lab, rows, cols, layouts[i]);
+      add_random_borders (&lab, &seed);
+
+      /* the same random positions for every layout */
+      lcg pos_seed = 7;
+      char label[40];
+      sprintf (label, "%s: visible rooms", names[i]);
+      mb_measure (label, 100000, {
+        int r = lcg_rand (&pos_seed) % rows;
+        int c = lcg_rand (&pos_seed) % cols;
+        laby_mark_visible_rooms (&lab, r, c, 5);
+      });
+
+      pos_seed = 7;
+      sprintf (label, "%s: viewport", names[i]);
+      mb_measure (label, 1000, {
+        Render render = DEFAULT_RENDER;
+        /* the viewport is inside the labyrinth */
+        render.visible_rows_pad
+            = lcg_rand (&pos_seed) % (rows - render.visible_rows);
+        render.visible_cols_pad
+            = lcg_rand (&pos_seed) % (cols - render.visible_cols);
+        render_laby (&render, &lab, DLM_WHOLE);
+        u8_buffer_free (&render.buf);
+      });
+      laby_free (&lab);
+    }
+
+  /* the known plane is interleaved with others, so every page is touched */
+  mb_measure_memory ("rows: 20000x20000 empty", {
+    Laby lab;
+    laby_init (&lab, 20000, 20000, LL_ROWS);
+    laby_fill_rect (&lab, LP_KNOWN, 0, 0, 20000, 20000, 1);
+    laby_free (&lab);
+  });
+}
+
+static void
+laby_file_bench ()
+{
+  int n = 8000;
+  const char *path = "/tmp/laby_file_bench.laby";
+  Laby lab;
+  laby_init_empty (&lab, n, n);
+  mb_measure ("save 8000x8000", 1, laby_save_file (&lab, 0, path));
+  laby_free (&lab);
+
+  int borders = 0;
+  mb_measure ("init 8000x8000 in memory", 3, {
+    laby_init_empty (&lab, n, n);
+    borders += laby_get_borders (&lab, n / 2, n / 2);
+    laby_free (&lab);
+  });
+  mb_measure ("open 8000x8000 from the file", 3, {
+    laby_open_file (&lab, NULL, path);
+    borders += laby_get_borders (&lab, n / 2, n / 2);
+    laby_free (&lab);
+  });
+  remove (path);
+}
+
+static void
+laby_stream_bench ()
+{
+  /* 100M rooms */
+  int n = 10000;
+  const char *path = "/tmp/laby_stream_bench.save";
+  lcg seed = 1904;
+  Laby lab;
+  laby_init_empty (&lab, n, n);
+  add_random_borders (&lab, &seed);
+  laby_fill_rect (&lab, LP_KNOWN, n / 4, n / 4, n / 2, n / 2, 1);
+
+  FILE *f = fopen (path, "wb");
+  mb_measure ("write 10000x10000", 1, laby_write (&lab, f));
+  fclose (f);
+  laby_free (&lab);
+
+  f = fopen (path, "rb");
+  mb_measure ("read 10000x10000", 1, laby_read (&lab, f));
+  fclose (f);
+  laby_free (&lab);
+  remove (path);
+}
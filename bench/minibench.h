@@ -0,0 +1,162 @@
+/**
+ * A tiny benchmark harness in the spirit of minunit.h: every benchmark is a
+ * function which runs the measured code `n` times and the harness prints the
+ * average time of a single run, or the median and the 99th percentile of
+ * all runs. Results are also written as JSON to bench_json, if it's set.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+extern char *bench_only;
+
+/* The name of the running benchmark */
+extern const char *bench_current;
+
+/* The file for results as the JSON array of records, or NULL */
+extern FILE *bench_json;
+
+/* The count of records written to bench_json */
+extern int bench_json_records;
+
+static inline double
+mb_now ()
+{
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+/* Starts the next record of bench_json with the name and the label */
+static inline void
+mb_json_record (const char *label, int runs)
+{
+  fprintf (bench_json,
+           "%s\n  { \"bench\": \"%s\", \"label\": \"%s\", \"runs\": %d",
+           (bench_json_records++ > 0) ? "," : "", bench_current, label, runs);
+}
+
+static int
+mb_compare_times (const void *a, const void *b)
+{
+  double x = *(const double *)a;
+  double y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+/**
+ * Prints the median and the 99th percentile (by the nearest rank) of times
+ * of the runs. The times are sorted.
+ */
+static inline void
+mb_report_runs (const char *label, double *times, int n, int warmup)
+{
+  qsort (times, n, sizeof (double), mb_compare_times);
+  double sum = 0;
+  for (int i = 0; i < n; i++)
+    sum += times[i];
+  double median = (n % 2) ? times[n / 2]
+                          : (times[n / 2 - 1] + times[n / 2]) / 2;
+  double p99 = times[(99 * n + 99) / 100 - 1];
+  printf ("   %-40s %14.3f us %14.3f us p99\n", label, median * 1e6,
+          p99 * 1e6);
+  if (bench_json == NULL)
+    return;
+  mb_json_record (label, n);
+  fprintf (bench_json,
+           ", \"warmup\": %d, \"min_ns\": %.0f, \"median_ns\": %.0f, "
+           "\"p99_ns\": %.0f, \"max_ns\": %.0f, \"mean_ns\": %.0f }",
+           warmup, times[0] * 1e9, median * 1e9, p99 * 1e9,
+           times[n - 1] * 1e9, sum / n * 1e9);
+}
+
+/**
+ * Runs the `code` `n` times and prints the average time of one run.
+ */
+#define mb_measure(label, n, code)                                            \
+  do                                                                          \
+    {                                                                         \
+      double _start = mb_now ();                                              \
+      for (int _i = 0; _i < (n); _i++)                                        \
+        {                                                                     \
+          code;                                                               \
+        }                                                                     \
+      double _avg = (mb_now () - _start) / (n);                               \
+      printf ("   %-40s %14.3f us\n", label, _avg * 1e6);                     \
+      if (bench_json)                                                         \
+        {                                                                     \
+          mb_json_record (label, n);                                          \
+          fprintf (bench_json, ", \"mean_ns\": %.0f }", _avg * 1e9);          \
+        }                                                                     \
+    }                                                                         \
+  while (0)
+
+/**
+ * Runs the `code` `warmup` times without measuring, then `n` times measuring
+ * every run, and prints the median and the 99th percentile of the runs.
+ */
+#define mb_measure_runs(label, warmup, n, code)                               \
+  do                                                                          \
+    {                                                                         \
+      for (int _i = 0; _i < (warmup); _i++)                                   \
+        {                                                                     \
+          code;                                                               \
+        }                                                                     \
+      double *_times = malloc (sizeof (double) * (n));                        \
+      for (int _i = 0; _i < (n); _i++)                                        \
+        {                                                                     \
+          double _start = mb_now ();                                          \
+          code;                                                               \
+          _times[_i] = mb_now () - _start;                                    \
+        }                                                                     \
+      mb_report_runs (label, _times, n, warmup);                              \
+      free (_times);                                                          \
+    }                                                                         \
+  while (0)
+
+/**
+ * Runs the `code` once in a child process and prints the time of the run and
+ * the peak memory of the child. The child doesn't share memory usage with
+ * other benchmarks.
+ */
+#define mb_measure_memory(label, code)                                        \
+  do                                                                          \
+    {                                                                         \
+      fflush (stdout);                                                        \
+      double _start = mb_now ();                                              \
+      pid_t _pid = fork ();                                                   \
+      if (_pid == 0)                                                          \
+        {                                                                     \
+          code;                                                               \
+          _exit (0);                                                          \
+        }                                                                     \
+      int _status;                                                            \
+      struct rusage _usage;                                                   \
+      wait4 (_pid, &_status, 0, &_usage);                                     \
+      double _time = mb_now () - _start;                                      \
+      printf ("   %-40s %14.3f us %10ld KB\n", label, _time * 1e6,            \
+              _usage.ru_maxrss);                                              \
+      if (bench_json)                                                         \
+        {                                                                     \
+          mb_json_record (label, 1);                                          \
+          fprintf (bench_json, ", \"mean_ns\": %.0f, \"max_rss_kb\": %ld }",  \
+                   _time * 1e9, _usage.ru_maxrss);                            \
+        }                                                                     \
+    }                                                                         \
+  while (0)
+
+#define mb_run_bench(bench)                                                   \
+  do                                                                          \
+    {                                                                         \
+      if (bench_only == NULL || strstr (#bench, bench_only) != NULL)          \
+        {                                                                     \
+          printf (" * " #bench ":\n");                                        \
+          bench_current = #bench;                                             \
+          bench ();                                                           \
+        }                                                                     \
+    }                                                                         \
+  while (0)
@@ -1,4 +1,5 @@
 #include "game.h"
+#include "laby_gen.h"
 #include "render.h"
 #include "term.h"
 #include <stdio.h>
@@ -20,6 +21,22 @@ int terminal_window_width = 0;
 static int laby_rows = 0;
 static int laby_cols = 0;
 
+/* the algorithm to generate labyrinths */
+static const Laby_Generator *generator = &laby_generators[0];
+
+/* the file with the pre-generated labyrinth */
+static const char *laby_file = NULL;
+/* the file to save the generated labyrinth instead of running the game */
+static const char *output_file = NULL;
+
+/* the count of steps from the player to the exit, or 0 to place the exit
+ * by the percentile of distances to all rooms */
+static long exit_distance = 0;
+static int exit_percentile = DEFAULT_EXIT_PERCENTILE;
+
+/* 0 to always generate labyrinths without the disk cache */
+static _Bool use_cache = 1;
+
 void
 refresh_screen (int sig)
 {
@@ -31,10 +48,8 @@ refresh_screen (int sig)
 static int
 parse_args (int argc, char *argv[])
 {
-  seed = time (NULL);
-
   int p;
-  while ((p = getopt (argc, argv, "h s: r: c:")) != -1)
+  while ((p = getopt (argc, argv, "h e n s: r: c: f: o: g: d: p:")) != -1)
     {
       switch (p)
         {
@@ -47,6 +62,21 @@ parse_args (int argc, char *argv[])
               "-s", "an initial seed of the game. Used to generate levels.");
           help_option ("-r", "the rows count of the labyrinth.");
           help_option ("-c", "the cols count of the labyrinth.");
+          help_option ("-e", "the endless labyrinth, which is generated "
+                             "while the player goes down.");
+          help_option ("-g", "the algorithm to generate labyrinths: eller "
+                             "(default), eller2, kruskal, wilson, "
+                             "backtracker.");
+          help_option ("-f", "the file with the labyrinth to play.");
+          help_option ("-o", "the file to save the generated labyrinth "
+                             "instead of playing.");
+          help_option ("-d", "the count of steps from the player to the "
+                             "exit.");
+          help_option ("-p", "the exit is placed in the count of steps "
+                             "enough to reach this percent of rooms "
+                             "(50 by default).");
+          help_option ("-n", "don't keep generated labyrinths in the disk "
+                             "cache, and don't load them from it.");
           // clang-format off
           help_title ("KEYS SETTINGS");
           printf( \
@@ -64,6 +94,26 @@ parse_args (int argc, char *argv[])
           printf("Vladimir Popov <vladimir@dokwork.ru>\n");
           // clang-format on
           return -1;
+        case 'g':
+          generator = laby_find_generator (optarg);
+          if (generator == NULL)
+            {
+              fprintf (stderr, "Unknown algorithm '%s'.\n", optarg);
+              return -1;
+            }
+          break;
+        case 'f':
+          laby_file = optarg;
+          break;
+        case 'o':
+          output_file = optarg;
+          break;
+        case 'e':
+          laby_rows = LABY_ENDLESS_ROWS;
+          break;
+        case 'n':
+          use_cache = 0;
+          break;
         case 's':
           seed = strtol (optarg, NULL, 0);
           break;
@@ -73,6 +123,17 @@ parse_args (int argc, char *argv[])
         case 'c':
           laby_cols = strtol (optarg, NULL, 0);
           break;
+        case 'd':
+          exit_distance = strtol (optarg, NULL, 0);
+          break;
+        case 'p':
+          exit_percentile = strtol (optarg, NULL, 0);
+          if (exit_percentile < 0 || exit_percentile > 100)
+            {
+              fprintf (stderr, "The percentile should be from 0 to 100.\n");
+              return -1;
+            }
+          break;
         case '?':
           if (optopt == 's')
             fprintf (stderr, "The -s argument should be followed by a number, "
@@ -83,6 +144,17 @@ parse_args (int argc, char *argv[])
           else if (optopt == 'c')
             fprintf (stderr, "The -c argument should be followed by a count "
                              "of rooms in the labyrinth by horizontal.");
+          else if (optopt == 'd' || optopt == 'p')
+            fprintf (stderr, "The -%c argument should be followed by a "
+                             "number.",
+                     optopt);
+          else if (optopt == 'g')
+            fprintf (stderr, "The -g argument should be followed by a name "
+                             "of the algorithm.");
+          else if (optopt == 'f' || optopt == 'o')
+            fprintf (stderr, "The -%c argument should be followed by a path "
+                             "to the file with the labyrinth.",
+                     optopt);
           else
             fprintf (stderr, "Unknown option character '%c'.\n", optopt);
           return -1;
@@ -91,25 +163,89 @@ parse_args (int argc, char *argv[])
   return 0;
 }
 
+/* Generates the labyrinth and saves it to the output file */
+static int
+save_laby ()
+{
+  if (laby_rows == LABY_ENDLESS_ROWS)
+    {
+      fprintf (stderr, "The endless labyrinth can't be saved.\n");
+      return -1;
+    }
+  lcg s = seed;
+  int res;
+  /* the rows of the Eller's algorithm, the default generator, are written
+   * right after generation, so labyrinths bigger than the memory can be
+   * saved */
+  if (generator == &laby_generators[0])
+    res = laby_generate_file (laby_rows, laby_cols, &s, output_file);
+  else
+    {
+      Laby lab;
+      if (generator->generate (&lab, laby_rows, laby_cols, &s) != 0)
+        {
+          perror (generator->name);
+          return -1;
+        }
+      res = laby_save_file (&lab, seed, output_file);
+      laby_free (&lab);
+    }
+  if (res != 0)
+    perror (output_file);
+  return res;
+}
+
+/* Checks the file with the labyrinth and takes the size and the seed */
+static int
+check_laby_file ()
+{
+  Laby lab;
+  lcg file_seed;
+  if (laby_open_file (&lab, &file_seed, laby_file) != 0)
+    {
+      perror (laby_file);
+      return -1;
+    }
+  laby_rows = lab.rows;
+  laby_cols = lab.cols;
+  seed = (seed > 0) ? seed : file_seed;
+  laby_free (&lab);
+  return 0;
+}
+
 int
 main (int argc, char *argv[])
 {
   if (parse_args (argc, argv) != 0)
     return -1;
 
-  enter_safe_raw_mode ();
-  handle_windows_resize (refresh_screen);
-  refresh_screen (0);
-  hide_cursor ();
-
   Render render = DEFAULT_RENDER;
 
+  if (laby_file && check_laby_file () != 0)
+    return -1;
+
   seed = (seed > 0) ? seed : time (NULL);
   laby_rows = (laby_rows > 0) ? laby_rows : render.visible_rows;
   laby_cols = (laby_cols > 0) ? laby_cols : render.visible_cols;
 
+  if (output_file)
+    return save_laby ();
+
+  enter_safe_raw_mode ();
+  handle_windows_resize (refresh_screen);
+  refresh_screen (0);
+  hide_cursor ();
+
   Game game;
   game_init (&game, laby_rows, laby_cols, seed);
+  game.laby_file = laby_file;
+  game.generator = generator;
+  game.exit_distance = exit_distance;
+  game.exit_percentile = exit_percentile;
+  /* the game is played without the cache, when it can't be opened */
+  static Laby_Cache cache;
+  if (use_cache && laby_cache_open (&cache, NULL, LABY_CACHE_MAX_SIZE) == 0)
+    game.cache = &cache;
   game_run_loop (&game, &render);
 
   clear_screen ();
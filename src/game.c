@@ -8,6 +8,8 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 static const int CONTINUE_LOOP = 1;
 
@@ -34,31 +36,112 @@ game_init (Game *game, int height, int width, int seed)
   game->seed = seed;
   game->laby_rows = height;
   game->laby_cols = width;
+  game->laby_file = NULL;
+  game->cache = NULL;
+  game->generator = &laby_generators[0];
+  game->exit_distance = 0;
+  game->exit_percentile = DEFAULT_EXIT_PERCENTILE;
   game->state_idx = 0;
+  memset (&game->lab, 0, sizeof (Laby));
+  game->next_started = 0;
+  game->solver_ready = 0;
+  game->render = NULL;
+  game->eller.sets = NULL;
+  game->eller.tmp = NULL;
+  game->eller.left = NULL;
+  game->eller.free_sets = NULL;
   game->states_stack
       = malloc (sizeof (enum game_state) * MAX_STATES_STACK_SIZE);
   game->states_stack[0] = ST_WELCOME_SCREEN;
   game->menu = create_menu (ST_WELCOME_SCREEN);
 }
 
+static void pregenerate_next_level (Game *game);
+static void drop_next_level (Game *game);
+static void drop_solver (Game *game);
+
 void
 game_run_loop (Game *game, Render *r)
 {
   enum command cmd;
+  game->render = r;
+  /* the first level is generated while the welcome screen is shown */
+  pregenerate_next_level (game);
   do
     {
       render (r, game);
       cmd = read_command (game);
     }
   while (handle_command (game, cmd));
+  /* the worker can still generate the level, which is not needed anymore */
+  drop_next_level (game);
+  drop_solver (game);
+}
+
+/* Generates rows of the endless labyrinth in front of the player */
+static void
+generate_rows_ahead (Game *game)
+{
+  if (L.layout != LL_RING)
+    return;
+  while (game->eller.row <= P.row + LABY_RING_ROWS / 2)
+    laby_eller_next_row (&game->eller, &L);
+}
+
+void
+game_choose_player_room (const Laby *lab, lcg *seed, Player *player)
+{
+  /* the endless laby is generated in front of the player */
+  int rows = (lab->layout == LL_RING) ? LABY_RING_ROWS / 4 : lab->rows;
+  player->row = lcg_rand (seed) % rows;
+  player->col = lcg_rand (seed) % lab->cols;
+  player->visible_range = 2;
+}
+
+void
+game_choose_exit_room (const Laby *lab, lcg *seed, const Player *player,
+                       long distance, int percentile, int *row, int *col)
+{
+  /* the endless laby doesn't have rooms far from the player yet */
+  if (lab->layout == LL_RING)
+    {
+      do
+        {
+          double a = (lcg_rand (seed) % 360) * M_PI / 180;
+          int r = 2 * player->visible_range * sin (a) + player->row;
+          int c = 2 * player->visible_range * cos (a) + player->col;
+          *row = (r < 0) ? 0 : r;
+          *col = (c < 0) ? 0 : (c >= lab->cols) ? lab->cols - 1 : c;
+        }
+      while (*row == player->row && *col == player->col);
+      return;
+    }
+
+  int res;
+  if (distance > 0)
+    res = laby_choose_room_at_distance (lab, player->row, player->col,
+                                        distance, seed, row, col);
+  else
+    /* the exit should not be in the room of the player */
+    res = laby_choose_room_at_percentile (lab, player->row, player->col,
+                                          percentile, 1, seed, row, col);
+  if (res == 0)
+    return;
+  /* the search can't allocate its memory, so any other room is taken */
+  do
+    {
+      *row = lcg_rand (seed) % lab->rows;
+      *col = lcg_rand (seed) % lab->cols;
+    }
+  while (*row == player->row && *col == player->col
+         && (long)lab->rows * lab->cols > 1);
 }
 
 static void
 game_init_player (Game *game)
 {
-  game->player.row = lcg_rand (&game->seed) % L.rows;
-  game->player.col = lcg_rand (&game->seed) % L.cols;
-  game->player.visible_range = 2;
+  game_choose_player_room (&L, &game->seed, &P);
+  generate_rows_ahead (game);
   laby_set_content (&L, P.row, P.col, C_PLAYER);
   laby_mark_visible_rooms (&L, P.row, P.col, P.visible_range);
 }
@@ -66,23 +149,128 @@ game_init_player (Game *game)
 static void
 game_place_exit (Game *game)
 {
-  double a = (lcg_rand (&game->seed) % 360) * M_PI / 180;
-  int r = 2 * P.visible_range * sin (a) + P.row;
-  int c = 2 * P.visible_range * cos (a) + P.col;
-  r = (r < 0) ? 0 : (r >= L.rows) ? L.rows - 1 : r;
-  c = (c < 0) ? 0 : (c >= L.cols) ? L.cols - 1 : c;
-  if (r == P.row && c == P.col)
-    game_place_exit (game);
-  else
-    laby_set_content (&L, r, c, C_EXIT);
+  int r, c;
+  game_choose_exit_room (&L, &game->seed, &P, game->exit_distance,
+                         game->exit_percentile, &r, &c);
+  laby_set_content (&L, r, c, C_EXIT);
+}
+
+/**
+ * Takes the labyrinth from the cache, or generates it and puts it to the
+ * cache. Small labyrinths are always generated.
+ */
+static void
+generate_laby (const Game *game, Laby *lab, lcg *seed)
+{
+  const char *name = game->generator->name;
+  int rows = game->laby_rows;
+  int cols = game->laby_cols;
+  _Bool cached = game->cache && (long)rows * cols >= LABY_CACHE_MIN_ROOMS;
+  if (cached
+      && laby_cache_load (game->cache, name, seed, rows, cols, lab) == 0)
+    return;
+  lcg first_seed = *seed;
+  if (game->generator->generate (lab, rows, cols, seed) != 0)
+    {
+      /* the Eller's algorithm needs no memory besides the labyrinth */
+      *seed = first_seed;
+      laby_generate (lab, rows, cols, seed);
+      return;
+    }
+  if (cached)
+    laby_cache_store (game->cache, name, first_seed, *seed, lab);
+}
+
+static void *
+generate_next_level (void *arg)
+{
+  Game *game = arg;
+  generate_laby (game, &game->next_lab, &game->next_seed);
+  atomic_store (&game->next_ready, 1);
+  return NULL;
+}
+
+/**
+ * Starts generation of the next labyrinth on a worker thread.
+ * The worker takes a copy of the current seed, so the levels are the same
+ * as when they are generated right before the game.
+ */
+static void
+pregenerate_next_level (Game *game)
+{
+  if (game->next_started || game->laby_file
+      || game->laby_rows == LABY_ENDLESS_ROWS)
+    return;
+  game->next_seed = game->seed;
+  atomic_store (&game->next_ready, 0);
+  game->next_started = pthread_create (&game->next_thread, NULL,
+                                       generate_next_level, game)
+                       == 0;
+}
+
+/**
+ * Replaces the current labyrinth by the pre-generated one. If the next
+ * labyrinth is not ready yet, the progress is shown until the worker ends.
+ * Returns 0 when nothing was pre-generated.
+ */
+static _Bool
+take_next_level (Game *game)
+{
+  if (!game->next_started)
+    return 0;
+  if (!atomic_load (&game->next_ready) && game->render)
+    {
+      struct timespec frame = { 0, 100 * 1000 * 1000 };
+      game_set_state (game, ST_GENERATING);
+      game->waiting_frames = 0;
+      while (!atomic_load (&game->next_ready))
+        {
+          render (game->render, game);
+          nanosleep (&frame, NULL);
+          game->waiting_frames++;
+        }
+      game_recover_prev_state (game);
+    }
+  pthread_join (game->next_thread, NULL);
+  game->next_started = 0;
+  L = game->next_lab;
+  game->seed = game->next_seed;
+  return 1;
+}
+
+/* Waits for the worker and frees the pre-generated labyrinth, if any */
+static void
+drop_next_level (Game *game)
+{
+  if (!game->next_started)
+    return;
+  pthread_join (game->next_thread, NULL);
+  game->next_started = 0;
+  laby_free (&game->next_lab);
 }
 
 static void
 generate_new_level (Game *game)
 {
-  laby_generate (&L, game->laby_rows, game->laby_cols, &game->seed);
+  drop_solver (game);
+  laby_free (&L);
+  if (game->laby_file)
+    {
+      /* the file was checked on start */
+      laby_open_file (&L, NULL, game->laby_file);
+    }
+  else if (game->laby_rows == LABY_ENDLESS_ROWS)
+    {
+      /* rows are generated while the player goes down */
+      laby_init (&L, LABY_ENDLESS_ROWS, game->laby_cols, LL_RING);
+      laby_eller_free (&game->eller);
+      laby_eller_init (&game->eller, game->laby_cols, game->seed, LEV_1);
+    }
+  else if (!take_next_level (game))
+    generate_laby (game, &L, &game->seed);
   game_init_player (game);
   game_place_exit (game);
+  pregenerate_next_level (game);
 }
 
 static void
@@ -118,19 +306,33 @@ handle_cmd_in_welcome_screen (Game *game, enum command cmd)
     }
 }
 
+/* Removes the rooms of the hint, which are shown until the next move */
 static void
-move_player (Game *game, int dr, int dc)
+clear_hint (Game *game)
 {
-  /* unmark visible rooms */
-  for (int i = P.row - P.visible_range; i <= P.row + P.visible_range; i++)
-    for (int j = P.col - P.visible_range; j <= P.col + P.visible_range; j++)
+  /* removed rooms are replaced by the last ones, which are checked already */
+  for (int i = L.content_count - 1; i >= 0; i--)
+    if (L.content[i].content == C_HINT)
       {
-        laby_set_visibility (&L, i, j, 0);
+        laby_fill_rect (&L, LP_VISIBLE, L.content[i].row, L.content[i].col, 1,
+                        1, 0);
+        laby_set_content (&L, L.content[i].row, L.content[i].col, C_NOTHING);
       }
+}
+
+static void
+move_player (Game *game, int dr, int dc)
+{
+  clear_hint (game);
+  /* unmark visible rooms */
+  int range = P.visible_range;
+  laby_fill_rect (&L, LP_VISIBLE, P.row - range, P.col - range, 2 * range + 1,
+                  2 * range + 1, 0);
   /* change player's position */
   laby_set_content (&L, P.row, P.col, C_NOTHING);
   P.row += dr;
   P.col += dc;
+  generate_rows_ahead (game);
   /* check collisions */
   if (laby_get_content (&L, P.row, P.col) == C_EXIT)
     {
@@ -155,7 +357,8 @@ handle_cmd_in_game (Game *game, enum command cmd)
         move_player (game, 0, -1);
       break;
     case CMD_MV_UP:
-      if ((P.row > 0) && !(border & UPPER_BORDER))
+      /* the rows out of the ring of the endless laby are lost */
+      if ((P.row > L.ring_first) && !(border & UPPER_BORDER))
         move_player (game, -1, 0);
       break;
     case CMD_MV_RIGHT:
@@ -241,6 +444,131 @@ handle_cmd_in_pause (Game *game, enum command cmd)
   return CONTINUE_LOOP;
 }
 
+static void
+save_game (Game *game)
+{
+  /* the previous save is replaced only by the complete one */
+  FILE *f = fopen (SAVE_FILE ".tmp", "wb");
+  if (f == NULL)
+    return;
+  int res = laby_write (&L, f);
+  if (fclose (f) == 0 && res == 0)
+    rename (SAVE_FILE ".tmp", SAVE_FILE);
+  else
+    remove (SAVE_FILE ".tmp");
+}
+
+static void
+load_game (Game *game)
+{
+  FILE *f = fopen (SAVE_FILE, "rb");
+  if (f == NULL)
+    return;
+  Laby lab;
+  int res = laby_read (&lab, f);
+  fclose (f);
+  if (res != 0)
+    return;
+
+  /* the player is kept in the labyrinth as a content */
+  int i = 0;
+  while (i < lab.content_count && lab.content[i].content != C_PLAYER)
+    i++;
+  if (i == lab.content_count)
+    {
+      laby_free (&lab);
+      return;
+    }
+  drop_solver (game);
+  laby_free (&L);
+  L = lab;
+  P.row = L.content[i].row;
+  P.col = L.content[i].col;
+  laby_mark_visible_rooms (&L, P.row, P.col, P.visible_range);
+}
+
+/* Frees the solver of the labyrinth, which is replaced or freed */
+static void
+drop_solver (Game *game)
+{
+  if (!game->solver_ready)
+    return;
+  laby_solver_free (&game->solver);
+  game->solver_ready = 0;
+}
+
+/**
+ * Finds the shortest path from the player to the exit by the solver of the
+ * level, which is built on the first call. Returns 0 when the path is not
+ * found, or the labyrinth is endless.
+ */
+static _Bool
+solve_laby (Game *game)
+{
+  /* the endless labyrinth is not kept whole */
+  if (L.layout == LL_RING)
+    return 0;
+  int i = 0;
+  while (i < L.content_count && L.content[i].content != C_EXIT)
+    i++;
+  if (i == L.content_count)
+    return 0;
+  if (!game->solver_ready)
+    {
+      if (laby_solver_init (&game->solver, &L) != 0)
+        return 0;
+      game->solver_ready = 1;
+    }
+  return laby_solve (&game->solver, P.row, P.col, L.content[i].row,
+                     L.content[i].col)
+         >= 0;
+}
+
+/* Lights up the next rooms of the shortest path to the exit */
+static void
+show_hint (Game *game)
+{
+  clear_hint (game);
+  if (!solve_laby (game))
+    return;
+  int r = P.row, c = P.col;
+  for (int i = 0;
+       i < HINT_ROOMS && laby_solver_next_room (&game->solver, &r, &c)
+                  && laby_get_content (&L, r, c) == C_NOTHING;
+       i++)
+    {
+      laby_set_content (&L, r, c, C_HINT);
+      laby_fill_rect (&L, LP_VISIBLE, r, c, 1, 1, 1);
+    }
+}
+
+/* Walks the player along the shortest path until the exit is reached */
+static void
+walk_to_exit (Game *game)
+{
+  if (!solve_laby (game))
+    return;
+  /* the path takes SOLVE_FRAMES frames at most */
+  long length = 0;
+  for (int r = P.row, c = P.col;
+       laby_solver_next_room (&game->solver, &r, &c);)
+    length++;
+  long rooms_per_frame = length / SOLVE_FRAMES + 1;
+  struct timespec frame = { 0, SOLVE_FRAME_NS };
+  int r = P.row, c = P.col;
+  for (long i = 1; GAME_STATE != ST_WIN
+                   && laby_solver_next_room (&game->solver, &r, &c);
+       i++)
+    {
+      move_player (game, r - P.row, c - P.col);
+      if (game->render && GAME_STATE != ST_WIN && i % rooms_per_frame == 0)
+        {
+          render (game->render, game);
+          nanosleep (&frame, NULL);
+        }
+    }
+}
+
 static int
 handle_cmd_in_cmd_mode (Game *game, enum command cmd)
 {
@@ -257,6 +585,37 @@ handle_cmd_in_cmd_mode (Game *game, enum command cmd)
       game->menu = NULL;
       laby_mark_whole_as_known (&L);
       return CONTINUE_LOOP;
+    case CMD_SHOW_STATS:
+      game_recover_prev_state (game);
+      close_menu (game->menu, ST_CMD);
+      game->menu = NULL;
+      /* the endless labyrinth is not kept whole */
+      if (L.layout != LL_RING)
+        {
+          if (laby_compute_stats (&L, &game->stats) == 0)
+            game_set_state (game, ST_STATS);
+        }
+      return CONTINUE_LOOP;
+    case CMD_SAVE:
+    case CMD_LOAD:
+      game_recover_prev_state (game);
+      close_menu (game->menu, ST_CMD);
+      game->menu = NULL;
+      if (cmd == CMD_SAVE)
+        save_game (game);
+      else
+        load_game (game);
+      return CONTINUE_LOOP;
+    case CMD_SOLVE:
+    case CMD_HINT:
+      game_recover_prev_state (game);
+      close_menu (game->menu, ST_CMD);
+      game->menu = NULL;
+      if (cmd == CMD_SOLVE)
+        walk_to_exit (game);
+      else
+        show_hint (game);
+      return CONTINUE_LOOP;
     case CMD_NEW_GAME:
       run_new_game (game);
       return CONTINUE_LOOP;
@@ -290,6 +649,19 @@ handle_cmd_in_keys_settings (Game *game, enum command cmd)
     }
 }
 
+static int
+handle_cmd_in_stats (Game *game, enum command cmd)
+{
+  switch (cmd)
+    {
+    case CMD_CONTINUE:
+      game_recover_prev_state (game);
+      return CONTINUE_LOOP;
+    default:
+      return CONTINUE_LOOP;
+    }
+}
+
 static int
 handle_cmd_in_win (Game *game, enum command cmd)
 {
@@ -324,5 +696,9 @@ handle_command (Game *game, enum command cmd)
       return handle_cmd_in_cmd_mode (game, cmd);
     case ST_KEY_SETTINGS:
       return handle_cmd_in_keys_settings (game, cmd);
+    case ST_STATS:
+      return handle_cmd_in_stats (game, cmd);
+    case ST_GENERATING:
+      return CONTINUE_LOOP;
     }
 }
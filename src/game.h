@@ -2,11 +2,34 @@
 #define __LABYRINTH_GAME__
 
 #include "laby.h"
+#include "laby_cache.h"
+#include "laby_gen.h"
+#include "laby_solver.h"
+#include "laby_stats.h"
+#include <pthread.h>
+#include <stdatomic.h>
 
 /* The max count of states in the stack of game states
  * is limited by logic and should not be overflowed  */
 #define MAX_STATES_STACK_SIZE 5
 
+/* The percentile of distances from the player to all rooms,
+ * where the exit is placed by default */
+#define DEFAULT_EXIT_PERCENTILE 50
+
+/* The count of rooms of the path to the exit shown by the hint */
+#define HINT_ROOMS 5
+
+/* The max count of frames to animate the solution, longer paths are passed
+ * by a few rooms per frame */
+#define SOLVE_FRAMES 250
+
+/* The duration of the frame of the solution in nanoseconds */
+#define SOLVE_FRAME_NS (20 * 1000 * 1000)
+
+/* The file in the current directory to save and load the game */
+#define SAVE_FILE "labyrinth.save"
+
 /* The macros to take the current game state */
 #define GAME_STATE game->states_stack[game->state_idx]
 #define GAME_PREV_STATE                                                       \
@@ -45,7 +68,17 @@ enum command
   /* Show keys settings menu */
   CMD_SHOW_KEYS_SETTINGS,
   /* Cheat to show whole labyrinth */
-  CMD_SHOW_ALL
+  CMD_SHOW_ALL,
+  /* Save the current labyrinth and the player to the SAVE_FILE */
+  CMD_SAVE,
+  /* Load the labyrinth and the player from the SAVE_FILE */
+  CMD_LOAD,
+  /* Show the metrics of the current labyrinth */
+  CMD_SHOW_STATS,
+  /* Walk the player along the shortest path to the exit */
+  CMD_SOLVE,
+  /* Show the next rooms of the shortest path to the exit */
+  CMD_HINT
 };
 
 enum game_state
@@ -63,7 +96,11 @@ enum game_state
   /* The message about victory is shown */
   ST_WIN,
   /* The game is on pause and waiting a special command from user */
-  ST_CMD
+  ST_CMD,
+  /* The player waits until the next labyrinth is generated */
+  ST_GENERATING,
+  /* The metrics of the current labyrinth are shown */
+  ST_STATS
 };
 
 enum laby_draw_mode
@@ -84,8 +121,8 @@ typedef struct menu Menu;
 
 typedef struct
 {
-  unsigned char row;
-  unsigned char col;
+  int row;
+  int col;
   /* The radius of visible distance including the y:x.
    * 1 means that only current y:x room is visible.
    * 0 turns off visibility check completely. */
@@ -97,10 +134,21 @@ typedef struct
   /* Global configuration of the game */
   /* ------------------------------- */
   lcg seed;
-  /* The count of rooms by vertical in the new laby */
+  /* The count of rooms by vertical in the new laby,
+   * or LABY_ENDLESS_ROWS for the endless laby */
   int laby_rows;
   /* The count of rooms by horizontal in the new laby */
   int laby_cols;
+  /* The algorithm to generate a new laby */
+  const Laby_Generator *generator;
+  /* The file with the pre-generated laby, or NULL to generate a new one */
+  const char *laby_file;
+  /* The cache of giant labyrinths, or NULL to always generate them */
+  const Laby_Cache *cache;
+  /* The count of steps from the player to the exit, or 0 to place the exit
+   * by the percentile of distances to all rooms */
+  long exit_distance;
+  int exit_percentile;
 
   Render *render;
   /* ------------------------------- */
@@ -111,6 +159,28 @@ typedef struct
   unsigned char state_idx;
   /* The current labyrinth */
   Laby lab;
+  /* The generator of rows of the endless labyrinth */
+  Laby_Eller eller;
+  /* The next labyrinth, which is generated in the background
+   * while the current level is played */
+  Laby next_lab;
+  /* The seed right after generation of the next labyrinth */
+  lcg next_seed;
+  /* The thread which generates the next labyrinth */
+  pthread_t next_thread;
+  /* 1 when the thread for the next labyrinth was started */
+  _Bool next_started;
+  /* 1 when the next labyrinth is completely generated */
+  atomic_bool next_ready;
+  /* The count of frames rendered while the next labyrinth is waited */
+  unsigned int waiting_frames;
+  /* The metrics of the current labyrinth for the ST_STATS state */
+  Laby_Stats stats;
+  /* The solver of paths to the exit of the current labyrinth, which is
+   * built by the first hint or solve of the level */
+  Laby_Solver solver;
+  /* 1 when the solver is built for the current labyrinth */
+  _Bool solver_ready;
   /* The current state of the player */
   Player player;
   /* Implementation of a menu depends on runtime.
@@ -126,6 +196,22 @@ void game_init (Game *game, int rows, int cols, int seed);
 
 void game_run_loop (Game *game, Render *render);
 
+/**
+ * Chooses the room of the player in the new labyrinth. The seed is the one
+ * right after generation of the labyrinth.
+ */
+void game_choose_player_room (const Laby *lab, lcg *seed, Player *player);
+
+/**
+ * Chooses the room of the exit in `distance` steps from the player, or, when
+ * the distance is 0, in the count of steps enough to reach `percentile`
+ * percents of rooms. The exit of the endless labyrinth is placed near the
+ * player.
+ */
+void game_choose_exit_room (const Laby *lab, lcg *seed, const Player *player,
+                            long distance, int percentile, int *row,
+                            int *col);
+
 void menu_next_option (Menu *menu);
 
 void menu_prev_option (Menu *menu);
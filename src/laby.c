@@ -6,121 +6,910 @@
 #include "laby.h"
 #include "2d_math.h"
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
 #include <math.h>
+#include <pthread.h>
 #include <stdio.h>
 #include <stdlib.h>
-
-#define VISIBLE_MASK 0x10
-#define KNOWN_MASK 0x20
-
-#define CONTENT_SHIFT 6
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 #define min(a, b) ((a < b) ? a : b)
 #define max(a, b) ((a > b) ? a : b)
 
+/* The mask with `n` low bits set (n is in 1...64) */
+#define low_bits(n) (~(uint64_t)0 >> (64 - (n)))
+
 /* To calculate visibility we take the size of the room as NxN */
 static const int N = 9;
 
-/* Creates a new labyrinth with height x width empty rooms. */
-void
-laby_init_empty (Laby *lab, int height, int width)
+/* The index of the tile (or word) with the padded row (column) */
+#define tile_idx(p) ((p) >> 6)
+
+/* The row of the tile (or bit of the word) with the padded row (column) */
+#define tile_off(p) ((p)&63)
+
+/* The count of different kinds of shared tiles (see tile_kind) */
+#define TEMPLATES_COUNT 16
+
+/**
+ * Returns the kind of the row (or column) t of tiles, where `last` is the row
+ * (column) of tiles with the last row (column) of the labyrinth:
+ * 0 - the first tiles with sentinels before the labyrinth;
+ * 1 - tiles between the first and the last, only with outer borders;
+ * 2 - the last tiles with the outer borders;
+ * 3 - tiles after the last, only with sentinels without borders.
+ * All not allocated tiles of the same kind by vertical and horizontal have
+ * the same bits.
+ */
+static inline int
+tile_kind (long t, long last)
+{
+  return (t == 0) ? 0 : (t < last) ? 1 : (t == last) ? 2 : 3;
+}
+
+/* Returns the row (or column) of tiles with the kind, or -1 if it's absent */
+static long
+tile_of_kind (int kind, long last, long count)
+{
+  long t = (kind == 0) ? 0 : (kind == 1) ? 1 : (kind == 2) ? last : last + 1;
+  return (t < count && tile_kind (t, last) == kind) ? t : -1;
+}
+
+/* Returns the shared tile which is used instead of not allocated tile tr:tc */
+static inline uint64_t *
+tile_template (const Laby *lab, long tr, long tc)
+{
+  long last_r = tile_idx (lab->rows - 1 + LABY_PAD);
+  long last_c = tile_idx (lab->cols - 1 + LABY_PAD);
+  int k = tile_kind (tr, last_r) * 4 + tile_kind (tc, last_c);
+  return &lab->templates[k * LABY_TILE_WORDS];
+}
+
+static inline _Bool
+is_template (const Laby *lab, const uint64_t *tile)
+{
+  return tile >= lab->templates
+         && tile < lab->templates + TEMPLATES_COUNT * LABY_TILE_WORDS;
+}
+
+/* Returns the tile tr:tc for reading */
+static inline const uint64_t *
+get_tile (const Laby *lab, long tr, long tc)
+{
+  uint64_t **page = lab->pages[(tr / LABY_PAGE_SIDE) * lab->pages_cols
+                               + tc / LABY_PAGE_SIDE];
+  return (page) ? page[(tr % LABY_PAGE_SIDE) * LABY_PAGE_SIDE
+                       + tc % LABY_PAGE_SIDE]
+                : tile_template (lab, tr, tc);
+}
+
+/* Returns the pointer to the tile tr:tc in the directory. Allocates the page
+ * of the directory if it's needed. */
+static uint64_t **
+get_tile_ref (Laby *lab, long tr, long tc)
+{
+  uint64_t ***page = &lab->pages[(tr / LABY_PAGE_SIDE) * lab->pages_cols
+                                 + tc / LABY_PAGE_SIDE];
+  if (*page == NULL)
+    {
+      long tr0 = tr - tr % LABY_PAGE_SIDE;
+      long tc0 = tc - tc % LABY_PAGE_SIDE;
+      *page = malloc (sizeof (uint64_t *) * LABY_PAGE_SIDE * LABY_PAGE_SIDE);
+      for (int i = 0; i < LABY_PAGE_SIDE; i++)
+        for (int j = 0; j < LABY_PAGE_SIDE; j++)
+          (*page)[i * LABY_PAGE_SIDE + j]
+              = tile_template (lab, tr0 + i, tc0 + j);
+      lab->pages_count++;
+    }
+  return &(*page)[(tr % LABY_PAGE_SIDE) * LABY_PAGE_SIDE
+                  + tc % LABY_PAGE_SIDE];
+}
+
+/* Returns the tile tr:tc for writing. Allocates the tile if it's needed. */
+static uint64_t *
+get_tile_for_write (Laby *lab, long tr, long tc)
+{
+  uint64_t **tile = get_tile_ref (lab, tr, tc);
+  if (is_template (lab, *tile))
+    {
+      uint64_t *copy = malloc (sizeof (uint64_t) * LABY_TILE_WORDS);
+      memcpy (copy, *tile, sizeof (uint64_t) * LABY_TILE_WORDS);
+      *tile = copy;
+      lab->tiles_count++;
+    }
+  return *tile;
+}
+
+/**
+ * Returns the word of the plane p with the bit of the room in the padded row
+ * pr and column pc. The padded row (column) is the row (column) of the room
+ * plus LABY_PAD.
+ */
+static inline const uint64_t *
+get_word (const Laby *lab, enum laby_plane p, long pr, long pc)
+{
+  /* only the layouts of rows have the stride */
+  if (lab->stride)
+    return &lab->words[((pr & lab->rows_mask) * lab->stride + tile_idx (pc))
+                           * LP_COUNT
+                       + p];
+
+  return &get_tile (lab, tile_idx (pr),
+                    tile_idx (pc))[tile_off (pr) * LP_COUNT + p];
+}
+
+/* The same as get_word, but the word can be changed */
+static inline uint64_t *
+get_word_for_write (Laby *lab, enum laby_plane p, long pr, long pc)
+{
+  /* only the layouts of rows have the stride */
+  if (lab->stride)
+    return &lab->words[((pr & lab->rows_mask) * lab->stride + tile_idx (pc))
+                           * LP_COUNT
+                       + p];
+
+  return &get_tile_for_write (lab, tile_idx (pr),
+                              tile_idx (pc))[tile_off (pr) * LP_COUNT + p];
+}
+
+/* Returns 1 if the bit of the room r:c is set in the plane p. The room must
+ * be inside the labyrinth or in the ring of sentinels. */
+static inline int
+test_bit (const Laby *lab, enum laby_plane p, int r, int c)
+{
+  long pc = c + LABY_PAD;
+  return (*get_word (lab, p, r + LABY_PAD, pc) >> tile_off (pc)) & 1;
+}
+
+static inline void
+set_bit (Laby *lab, enum laby_plane p, int r, int c)
+{
+  long pc = c + LABY_PAD;
+  *get_word_for_write (lab, p, r + LABY_PAD, pc) |= (uint64_t)1
+                                                     << tile_off (pc);
+}
+
+static inline void
+clear_bit (Laby *lab, enum laby_plane p, int r, int c)
+{
+  long pc = c + LABY_PAD;
+  *get_word_for_write (lab, p, r + LABY_PAD, pc) &= ~((uint64_t)1
+                                                      << tile_off (pc));
+}
+
+/**
+ * Sets (flag is 1) or clears (flag is 0) bits of the plane p for all rooms in
+ * the rectangle height x width with the upper left room r:c. The rectangle
+ * must not be empty, and can include sentinels. Not changed words are not
+ * written, so tiles are not allocated without need.
+ */
+static void
+fill_bits (Laby *lab, enum laby_plane p, int r, int c, int height, int width,
+           _Bool flag)
+{
+  long pc0 = c + LABY_PAD;
+  long pc1 = c + width - 1 + LABY_PAD;
+  uint64_t first = ~(uint64_t)0 << tile_off (pc0);
+  uint64_t last = low_bits (tile_off (pc1) + 1);
+  for (long pr = r + LABY_PAD; pr < r + height + LABY_PAD; pr++)
+    for (long w = tile_idx (pc0); w <= tile_idx (pc1); w++)
+      {
+        uint64_t mask = ~(uint64_t)0;
+        if (w == tile_idx (pc0))
+          mask &= first;
+        if (w == tile_idx (pc1))
+          mask &= last;
+        uint64_t word = *get_word (lab, p, pr, w << 6);
+        uint64_t new_word = (flag) ? word | mask : word & ~mask;
+        if (new_word != word)
+          *get_word_for_write (lab, p, pr, w << 6) = new_word;
+      }
+}
+
+/* Sets sentinels with the outer borders of the labyrinth in the tile tr:tc */
+static void
+set_tile_sentinels (const Laby *lab, uint64_t *tile, long tr, long tc)
+{
+  /* the first row and column of the labyrinth in the tile */
+  long r0 = (tr << 6) - LABY_PAD;
+  long c0 = (tc << 6) - LABY_PAD;
+  /* the columns of the labyrinth in the tile */
+  long from = max (c0, 0);
+  long to = min (c0 + 63, lab->cols - 1);
+  for (int i = 0; i < LABY_TILE_SIDE; i++)
+    {
+      long r = r0 + i;
+      uint64_t right = 0;
+      uint64_t bottom = 0;
+      if (r >= 0 && r < lab->rows)
+        {
+          if (c0 <= -1 && -1 <= c0 + 63)
+            right |= (uint64_t)1 << (-1 - c0);
+          if (c0 <= lab->cols - 1 && lab->cols - 1 <= c0 + 63)
+            right |= (uint64_t)1 << (lab->cols - 1 - c0);
+        }
+      if ((r == -1 || r == lab->rows - 1) && from <= to)
+        bottom = low_bits (to - from + 1) << (from - c0);
+      tile[i * LP_COUNT + LP_RIGHT] = right;
+      tile[i * LP_COUNT + LP_BOTTOM] = bottom;
+    }
+}
+
+/* Places the tile tr:tc to the slot of the block of tiles */
+static void
+place_tile (Laby *lab, long tr, long tc, long slot)
+{
+  uint64_t **tile = get_tile_ref (lab, tr, tc);
+  uint64_t *dest = &lab->words[slot * LABY_TILE_WORDS];
+  memcpy (dest, *tile, sizeof (uint64_t) * LABY_TILE_WORDS);
+  *tile = dest;
+  lab->tiles_count++;
+}
+
+/**
+ * Places tiles from the square side x side with the upper left tile tr:tc to
+ * the block of tiles in the Z-order, skipping tiles out of the labyrinth.
+ * @side must be a power of two.
+ * @slot the next free slot in the block.
+ */
+static void
+place_tiles_in_z_order (Laby *lab, long tr, long tc, long side,
+                        long tiles_rows, long tiles_cols, long *slot)
+{
+  if (tr >= tiles_rows || tc >= tiles_cols)
+    return;
+  if (side == 1)
+    {
+      place_tile (lab, tr, tc, (*slot)++);
+      return;
+    }
+  long h = side / 2;
+  place_tiles_in_z_order (lab, tr, tc, h, tiles_rows, tiles_cols, slot);
+  place_tiles_in_z_order (lab, tr, tc + h, h, tiles_rows, tiles_cols, slot);
+  place_tiles_in_z_order (lab, tr + h, tc, h, tiles_rows, tiles_cols, slot);
+  place_tiles_in_z_order (lab, tr + h, tc + h, h, tiles_rows, tiles_cols,
+                          slot);
+}
+
+/* Sets the size and the layout of the labyrinth without any memory */
+static void
+init_fields (Laby *lab, int height, int width, enum laby_layout layout)
 {
   lab->rows = height;
   lab->cols = width;
-  lab->rooms = malloc (sizeof (row) * height);
-  for (int i = 0; i < height; i++)
-    lab->rooms[i] = calloc (width, sizeof (room));
+  lab->layout = layout;
+  lab->map = NULL;
+  lab->map_size = 0;
+  lab->stride = 0;
+  lab->rows_mask = 0;
+  lab->ring_first = 0;
+  lab->words = NULL;
+  lab->pages_cols = 0;
+  lab->pages = NULL;
+  lab->templates = NULL;
+  lab->pages_count = 0;
+  lab->tiles_count = 0;
+  lab->content_count = 0;
+  lab->content = NULL;
+}
+
+void
+laby_init (Laby *lab, int height, int width, enum laby_layout layout)
+{
+  long prows = LABY_PAD + height + LABY_PAD_END;
+  long pcols = LABY_PAD + width + LABY_PAD_END;
+
+  init_fields (lab, height, width, layout);
+  if (layout == LL_ROWS || layout == LL_RING)
+    {
+      /* the ring keeps the rows -1 ... LABY_RING_ROWS - 2 at the beginning */
+      long words_rows = (layout == LL_RING) ? LABY_RING_ROWS : prows;
+      int walls_rows = (layout == LL_RING) ? min (height, LABY_RING_ROWS - 1)
+                                           : height;
+      lab->stride = tile_idx (pcols + 63);
+      lab->rows_mask = (layout == LL_RING) ? LABY_RING_ROWS - 1 : -1;
+      lab->words
+          = calloc (words_rows * lab->stride * LP_COUNT, sizeof (uint64_t));
+      /* the outer borders of the labyrinth */
+      fill_bits (lab, LP_RIGHT, 0, -1, walls_rows, 1, 1);
+      fill_bits (lab, LP_RIGHT, 0, width - 1, walls_rows, 1, 1);
+      fill_bits (lab, LP_BOTTOM, -1, 0, 1, width, 1);
+      if (height <= walls_rows)
+        fill_bits (lab, LP_BOTTOM, height - 1, 0, 1, width, 1);
+      return;
+    }
+
+  long tiles_rows = tile_idx (prows + 63);
+  long tiles_cols = tile_idx (pcols + 63);
+  lab->pages_cols = (tiles_cols + LABY_PAGE_SIDE - 1) / LABY_PAGE_SIDE;
+  lab->pages = calloc ((tiles_rows + LABY_PAGE_SIDE - 1) / LABY_PAGE_SIDE
+                           * lab->pages_cols,
+                       sizeof (uint64_t **));
+  /* the outer borders of the labyrinth are in the shared tiles */
+  lab->templates
+      = calloc (TEMPLATES_COUNT * LABY_TILE_WORDS, sizeof (uint64_t));
+  long last_r = tile_idx (height - 1 + LABY_PAD);
+  long last_c = tile_idx (width - 1 + LABY_PAD);
+  for (int kr = 0; kr < 4; kr++)
+    for (int kc = 0; kc < 4; kc++)
+      {
+        long tr = tile_of_kind (kr, last_r, tiles_rows);
+        long tc = tile_of_kind (kc, last_c, tiles_cols);
+        if (tr >= 0 && tc >= 0)
+          set_tile_sentinels (lab, tile_template (lab, tr, tc), tr, tc);
+      }
+
+  if (layout == LL_TILES)
+    return;
+
+  /* all tiles are allocated at once */
+  lab->words = malloc (sizeof (uint64_t) * LABY_TILE_WORDS * tiles_rows
+                       * tiles_cols);
+  long slot = 0;
+  if (layout == LL_BLOCKS)
+    for (long tr = 0; tr < tiles_rows; tr++)
+      for (long tc = 0; tc < tiles_cols; tc++)
+        place_tile (lab, tr, tc, slot++);
+  else
+    {
+      long side = 1;
+      while (side < tiles_rows || side < tiles_cols)
+        side *= 2;
+      place_tiles_in_z_order (lab, 0, 0, side, tiles_rows, tiles_cols, &slot);
+    }
+}
+
+void
+laby_ring_shift (Laby *lab, int first_row)
+{
+  /* the rows from the end of the ring to the new end, but not more than the
+   * whole ring */
+  int from = max ((long)lab->ring_first + LABY_RING_ROWS - 1,
+                  (long)first_row - 1);
+  int to = min ((long)first_row + LABY_RING_ROWS - 2, lab->rows - 1);
+  lab->ring_first = max (first_row, lab->ring_first);
+  for (int r = from; r <= to; r++)
+    {
+      /* the place of the row r - LABY_RING_ROWS is reused */
+      memset (get_word_for_write (lab, 0, r + LABY_PAD, 0), 0,
+              sizeof (uint64_t) * LP_COUNT * lab->stride);
+      set_bit (lab, LP_RIGHT, r, -1);
+      set_bit (lab, LP_RIGHT, r, lab->cols - 1);
+      if (r == lab->rows - 1)
+        fill_bits (lab, LP_BOTTOM, r, 0, 1, lab->cols, 1);
+    }
+}
+
+void
+laby_init_empty (Laby *lab, int height, int width)
+{
+  enum laby_layout layout
+      = ((long)height * width > LABY_MAX_ROWS_LAYOUT_ROOMS) ? LL_TILES
+                                                             : LL_ROWS;
+  laby_init (lab, height, width, layout);
 }
 
 /* Frees memory of the labyrinth. */
 void
 laby_free (Laby *lab)
 {
-  for (int i = 0; i < lab->rows; i++)
-    free (lab->rooms[i]);
+  if (lab->pages)
+    {
+      long tiles_rows = tile_idx (LABY_PAD + lab->rows + LABY_PAD_END + 63);
+      long pages_rows = (tiles_rows + LABY_PAGE_SIDE - 1) / LABY_PAGE_SIDE;
+      for (long i = 0; i < pages_rows * lab->pages_cols; i++)
+        {
+          uint64_t **page = lab->pages[i];
+          if (page == NULL)
+            continue;
+          /* tiles from the single block are freed with the block */
+          for (int j = 0; j < LABY_PAGE_SIDE * LABY_PAGE_SIDE; j++)
+            if (!lab->words && !is_template (lab, page[j]))
+              free (page[j]);
+          free (page);
+        }
+    }
+  if (lab->map)
+    munmap (lab->map, lab->map_size);
+  else
+    free (lab->words);
+  free (lab->pages);
+  free (lab->templates);
+  free (lab->content);
+  lab->pages = NULL;
+  lab->templates = NULL;
+  lab->words = NULL;
+  lab->map = NULL;
+  lab->map_size = 0;
+  lab->content = NULL;
+  lab->content_count = 0;
+}
+
+/* Returns the count of bytes allocated for the rooms of the labyrinth. */
+size_t
+laby_memory_usage (const Laby *lab)
+{
+  size_t size = sizeof (Laby_Content) * lab->content_count;
+  if (lab->layout == LL_ROWS)
+    return size
+           + sizeof (uint64_t) * LP_COUNT * lab->stride
+                 * (LABY_PAD + lab->rows + LABY_PAD_END);
+  if (lab->layout == LL_RING)
+    return size + sizeof (uint64_t) * LP_COUNT * lab->stride * LABY_RING_ROWS;
 
-  free (lab->rooms);
+  long tiles_rows = tile_idx (LABY_PAD + lab->rows + LABY_PAD_END + 63);
+  long pages_rows = (tiles_rows + LABY_PAGE_SIDE - 1) / LABY_PAGE_SIDE;
+  return size + sizeof (uint64_t **) * pages_rows * lab->pages_cols
+         + sizeof (uint64_t *) * LABY_PAGE_SIDE * LABY_PAGE_SIDE
+               * lab->pages_count
+         + sizeof (uint64_t) * LABY_TILE_WORDS
+               * (lab->tiles_count + TEMPLATES_COUNT);
 }
 
-/*  Returns only 4 first bits, which are about borders of the room. */
-unsigned char
-laby_get_borders (const Laby *lab, int r, int c)
+#define LABY_FILE_MAGIC "LABY"
+#define LABY_FILE_VERSION 1
+
+/* The buffer of the stream of rows written by laby_generate_file */
+#define LABY_FILE_BUFFER_SIZE (1 << 20)
+
+/**
+ * The header of the file with the labyrinth. The words of rooms follow the
+ * header in the LL_ROWS layout, including the sentinels. All numbers are in
+ * the byte order of the host.
+ */
+typedef struct
 {
-  int is_x_inside = c >= 0 && c < lab->cols;
-  int is_y_inside = r >= 0 && r < lab->rows;
+  char magic[4];
+  uint32_t version;
+  int32_t rows;
+  int32_t cols;
+  uint64_t seed;
+  /* The count of words after the header */
+  uint64_t words_count;
+} Laby_File_Header;
 
-  int border = 0;
+int
+laby_save_file (const Laby *lab, lcg seed, const char *path)
+{
+  long prows = LABY_PAD + lab->rows + LABY_PAD_END;
+  long stride = tile_idx (LABY_PAD + lab->cols + LABY_PAD_END + 63);
+  Laby_File_Header header = { LABY_FILE_MAGIC, LABY_FILE_VERSION, lab->rows,
+                              lab->cols, seed, prows * stride * LP_COUNT };
+  FILE *f = fopen (path, "wb");
+  if (f == NULL)
+    return -1;
 
-  if (is_y_inside && is_x_inside)
+  int ok = fwrite (&header, sizeof (header), 1, f) == 1;
+  /* the words of one padded row in the LL_ROWS layout */
+  uint64_t *row = malloc (sizeof (uint64_t) * stride * LP_COUNT);
+  for (long pr = 0; pr < prows && ok; pr++)
     {
-      border = lab->rooms[r][c];
-      if (r == 0)
-        border |= UPPER_BORDER;
-      if (c == 0)
-        border |= LEFT_BORDER;
-      if (r == lab->rows - 1)
-        border |= BOTTOM_BORDER;
-      if (c == lab->cols - 1)
-        border |= RIGHT_BORDER;
-    }
-  else if (is_x_inside && r == -1)
-    border = BOTTOM_BORDER;
-  else if (is_x_inside && r == lab->rows)
-    border = UPPER_BORDER;
-  else if (is_y_inside && c == -1)
-    border = RIGHT_BORDER;
-  else if (is_y_inside && c == lab->cols)
-    border = LEFT_BORDER;
-  else
-    border = 0;
+      if (lab->layout == LL_ROWS)
+        memcpy (row, get_word (lab, 0, pr, 0),
+                sizeof (uint64_t) * stride * LP_COUNT);
+      else
+        for (long w = 0; w < stride; w++)
+          for (int p = 0; p < LP_COUNT; p++)
+            row[w * LP_COUNT + p] = *get_word (lab, p, pr, w << 6);
+      ok = fwrite (row, sizeof (uint64_t), stride * LP_COUNT, f)
+           == stride * LP_COUNT;
+    }
+  free (row);
+  return (fclose (f) == 0 && ok) ? 0 : -1;
+}
+
+/* Writes the padded row pr of the LL_ROWS or LL_RING labyrinth to the file */
+static _Bool
+write_padded_row (const Laby *lab, long pr, FILE *f)
+{
+  long n = lab->stride * LP_COUNT;
+  return fwrite (get_word (lab, 0, pr, 0), sizeof (uint64_t), n, f) == n;
+}
+
+/* Writes the padded row of sentinels without any bits */
+static _Bool
+write_empty_row (const Laby *lab, FILE *f)
+{
+  const uint64_t zero = 0;
+  _Bool ok = 1;
+  for (long i = 0; i < lab->stride * LP_COUNT && ok; i++)
+    ok = fwrite (&zero, sizeof (zero), 1, f) == 1;
+  return ok;
+}
+
+int
+laby_generate_file (int height, int width, lcg *seed, const char *path)
+{
+  FILE *f = fopen (path, "wb");
+  if (f == NULL)
+    return -1;
+  setvbuf (f, NULL, _IOFBF, LABY_FILE_BUFFER_SIZE);
+
+  /* only the last rows are kept in memory */
+  Laby lab;
+  laby_init (&lab, height, width, LL_RING);
+  long prows = LABY_PAD + (long)height + LABY_PAD_END;
+  Laby_File_Header header = { LABY_FILE_MAGIC, LABY_FILE_VERSION, height,
+                              width, *seed, prows * lab.stride * LP_COUNT };
+  int ok = fwrite (&header, sizeof (header), 1, f) == 1;
+  /* the first sentinel row is out of the ring, but it's always empty */
+  ok = ok && write_empty_row (&lab, f);
+  ok = ok && write_padded_row (&lab, LABY_PAD - 1, f);
+
+  /* the same steps as laby_generate_eller does, but every row is written
+   * right after it's generated */
+  Laby_Eller eller;
+  laby_eller_init (&eller, width, *seed, LEV_1);
+  while (eller.row < height - 1 && ok)
+    {
+      laby_eller_next_row (&eller, &lab);
+      ok = write_padded_row (&lab, LABY_PAD + eller.row - 1, f);
+    }
+  for (int x = 0; x < width - 1; x++)
+    laby_rm_border (&lab, height - 1, x, RIGHT_BORDER);
+  ok = ok && write_padded_row (&lab, LABY_PAD + height - 1, f);
+  ok = ok && write_empty_row (&lab, f);
+
+  *seed = eller.seed;
+  laby_eller_free (&eller);
+  laby_free (&lab);
+  return (fclose (f) == 0 && ok) ? 0 : -1;
+}
+
+int
+laby_open_file (Laby *lab, lcg *seed, const char *path)
+{
+  int fd = open (path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  struct stat st;
+  Laby_File_Header header;
+  if (fstat (fd, &st) != 0
+      || read (fd, &header, sizeof (header)) != sizeof (header))
+    {
+      close (fd);
+      return -1;
+    }
+  long prows = LABY_PAD + (long)header.rows + LABY_PAD_END;
+  long stride = tile_idx (LABY_PAD + (long)header.cols + LABY_PAD_END + 63);
+  if (memcmp (header.magic, LABY_FILE_MAGIC, sizeof (header.magic)) != 0
+      || header.version != LABY_FILE_VERSION || header.rows <= 0
+      || header.cols <= 0
+      || header.words_count != (uint64_t)prows * stride * LP_COUNT
+      || (uint64_t)st.st_size
+             < sizeof (header) + sizeof (uint64_t) * header.words_count)
+    {
+      close (fd);
+      errno = EINVAL;
+      return -1;
+    }
+
+  /* pages are read from the file on the first access, and copied on the
+   * first write */
+  size_t size = st.st_size;
+  void *map = mmap (NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    return -1;
+
+  init_fields (lab, header.rows, header.cols, LL_ROWS);
+  lab->stride = stride;
+  lab->rows_mask = -1;
+  lab->map = map;
+  lab->map_size = size;
+  lab->words = (uint64_t *)((char *)map + sizeof (header));
+  if (seed)
+    *seed = header.seed;
+  return 0;
+}
+
+#define LABY_STREAM_MAGIC "LABS"
+#define LABY_STREAM_VERSION 1
 
-  return border & 0xf;
+/* The header of the stream written by laby_write */
+typedef struct
+{
+  char magic[4];
+  uint32_t version;
+  int32_t rows;
+  int32_t cols;
+  int32_t content_count;
+} Laby_Stream_Header;
+
+/* Writes the number by 7 bits per byte, the highest bit means "more" */
+static void
+write_varint (uint64_t n, FILE *f)
+{
+  while (n >= 0x80)
+    {
+      putc ((n & 0x7f) | 0x80, f);
+      n >>= 7;
+    }
+  putc (n, f);
+}
+
+/* Reads the number written by write_varint. Returns 0 on error. */
+static _Bool
+read_varint (uint64_t *n, FILE *f)
+{
+  *n = 0;
+  for (int shift = 0; shift < 64; shift += 7)
+    {
+      int b = getc (f);
+      if (b == EOF)
+        return 0;
+      *n |= (uint64_t)(b & 0x7f) << shift;
+      if (!(b & 0x80))
+        return 1;
+    }
+  return 0;
+}
+
+/* Returns 64 bits of the plane p for rooms of the row r from the column c */
+static inline uint64_t
+get_bits (const Laby *lab, enum laby_plane p, int r, int c)
+{
+  long pc = c + LABY_PAD;
+  int off = tile_off (pc);
+  uint64_t bits = *get_word (lab, p, r + LABY_PAD, pc) >> off;
+  /* the rest of bits are in the next word, if there are rooms */
+  if (off && c + 64 - off < lab->cols)
+    bits |= *get_word (lab, p, r + LABY_PAD, pc + 64) << (64 - off);
+  return bits;
+}
+
+/**
+ * Writes lengths of runs of unknown and known rooms in the row-major order.
+ * The first run is about unknown rooms and can be empty.
+ */
+static void
+write_known_runs (const Laby *lab, FILE *f)
+{
+  int known = 0;
+  uint64_t run = 0;
+  for (int r = 0; r < lab->rows; r++)
+    for (int c = 0; c < lab->cols; c += 64)
+      {
+        int n = min (64, lab->cols - c);
+        /* bits of rooms, which differ from the current run, are set */
+        uint64_t diff = get_bits (lab, LP_KNOWN, r, c) ^ -(uint64_t)known;
+        diff &= low_bits (n);
+        int i = 0;
+        while (diff)
+          {
+            int j = __builtin_ctzll (diff);
+            write_varint (run + j - i, f);
+            run = 0;
+            known = !known;
+            i = j;
+            diff = ~diff & low_bits (n) & (~(uint64_t)0 << i);
+          }
+        run += n - i;
+      }
+  write_varint (run, f);
+}
+
+/* Reads runs written by write_known_runs and marks known rooms */
+static _Bool
+read_known_runs (Laby *lab, FILE *f)
+{
+  long total = (long)lab->rows * lab->cols;
+  int known = 0;
+  uint64_t run;
+  for (long i = 0; i < total; i += run, known = !known)
+    {
+      if (!read_varint (&run, f) || run > total - i)
+        return 0;
+      /* the run can take a few rows */
+      for (long j = i; known && j < i + run;)
+        {
+          int r = j / lab->cols;
+          int c = j % lab->cols;
+          int n = min (i + run - j, (long)lab->cols - c);
+          fill_bits (lab, LP_KNOWN, r, c, 1, n, 1);
+          j += n;
+        }
+    }
+  return 1;
+}
+
+/* Sets bits of the plane p of the rooms of the row r from the column c */
+static void
+set_bits (Laby *lab, enum laby_plane p, int r, int c, uint64_t bits)
+{
+  long pc = c + LABY_PAD;
+  int off = tile_off (pc);
+  if (lab->cols - c < 64)
+    bits &= low_bits (lab->cols - c);
+  /* empty words are not written to not allocate tiles */
+  if (bits << off)
+    *get_word_for_write (lab, p, r + LABY_PAD, pc) |= bits << off;
+  if (off && bits >> (64 - off))
+    *get_word_for_write (lab, p, r + LABY_PAD, pc + 64) |= bits >> (64 - off);
+}
+
+/* Right and bottom borders take tile_idx (cols + 63) words of each plane */
+void
+laby_pack_row (const Laby *lab, int r, uint64_t *row)
+{
+  int words = tile_idx (lab->cols + 63);
+  for (int i = 0; i < words; i++)
+    {
+      row[i] = get_bits (lab, LP_RIGHT, r, i << 6);
+      row[words + i] = get_bits (lab, LP_BOTTOM, r, i << 6);
+    }
+  /* the bits after the last room are not needed */
+  if (tile_off (lab->cols))
+    {
+      row[words - 1] &= low_bits (tile_off (lab->cols));
+      row[2 * words - 1] &= low_bits (tile_off (lab->cols));
+    }
+}
+
+/* Adds borders of the row r packed by laby_pack_row */
+static void
+unpack_row (Laby *lab, int r, const uint64_t *row)
+{
+  int words = tile_idx (lab->cols + 63);
+  for (int i = 0; i < words; i++)
+    {
+      set_bits (lab, LP_RIGHT, r, i << 6, row[i]);
+      set_bits (lab, LP_BOTTOM, r, i << 6, row[words + i]);
+    }
+}
+
+size_t
+laby_packed_words (int rows, int cols)
+{
+  return (size_t)rows * tile_idx (cols + 63) * 2;
+}
+
+void
+laby_pack_borders (const Laby *lab, uint64_t *words)
+{
+  long row_words = tile_idx (lab->cols + 63) * 2;
+  for (int r = 0; r < lab->rows; r++)
+    laby_pack_row (lab, r, words + r * row_words);
+}
+
+void
+laby_unpack_borders (Laby *lab, int rows, int cols, const uint64_t *words)
+{
+  laby_init_empty (lab, rows, cols);
+  long row_words = tile_idx (cols + 63) * 2;
+  for (int r = 0; r < rows; r++)
+    unpack_row (lab, r, words + r * row_words);
+}
+
+int
+laby_write (const Laby *lab, FILE *f)
+{
+  if (lab->layout == LL_RING)
+    return -1;
+
+  Laby_Stream_Header header = { LABY_STREAM_MAGIC, LABY_STREAM_VERSION,
+                                lab->rows, lab->cols, lab->content_count };
+  if (fwrite (&header, sizeof (header), 1, f) != 1)
+    return -1;
+
+  /* only rooms of the labyrinth without sentinels */
+  int words = tile_idx (lab->cols + 63);
+  uint64_t *row = malloc (sizeof (uint64_t) * words * 2);
+  int ok = 1;
+  for (int r = 0; r < lab->rows && ok; r++)
+    {
+      laby_pack_row (lab, r, row);
+      ok = fwrite (row, sizeof (uint64_t), words * 2, f) == words * 2;
+    }
+  free (row);
+  if (!ok)
+    return -1;
+
+  write_known_runs (lab, f);
+  for (int i = 0; i < lab->content_count; i++)
+    {
+      write_varint (lab->content[i].row, f);
+      write_varint (lab->content[i].col, f);
+      write_varint (lab->content[i].content, f);
+    }
+  return ferror (f) ? -1 : 0;
+}
+
+int
+laby_read (Laby *lab, FILE *f)
+{
+  Laby_Stream_Header header;
+  if (fread (&header, sizeof (header), 1, f) != 1
+      || memcmp (header.magic, LABY_STREAM_MAGIC, sizeof (header.magic)) != 0
+      || header.version != LABY_STREAM_VERSION || header.rows <= 0
+      || header.cols <= 0 || header.content_count < 0)
+    return -1;
+
+  laby_init_empty (lab, header.rows, header.cols);
+  int words = tile_idx (lab->cols + 63);
+  uint64_t *row = malloc (sizeof (uint64_t) * words * 2);
+  int ok = 1;
+  for (int r = 0; r < lab->rows && ok; r++)
+    {
+      ok = fread (row, sizeof (uint64_t), words * 2, f) == words * 2;
+      if (ok)
+        unpack_row (lab, r, row);
+    }
+  free (row);
+
+  ok = ok && read_known_runs (lab, f);
+  for (int i = 0; i < header.content_count && ok; i++)
+    {
+      uint64_t r, c, content;
+      /* the numbers are checked before they are cut to int */
+      ok = read_varint (&r, f) && read_varint (&c, f)
+           && read_varint (&content, f) && r <= INT_MAX && c <= INT_MAX
+           && laby_is_inside (lab, r, c) && content <= C_HINT;
+      if (ok)
+        laby_set_content (lab, r, c, content);
+    }
+  if (!ok)
+    laby_free (lab);
+  return ok ? 0 : -1;
+}
+
+/*  Returns only 4 first bits, which are about borders of the room. */
+unsigned char
+laby_get_borders (const Laby *lab, int r, int c)
+{
+  assert (r >= -1 && r <= lab->rows && c >= -1 && c <= lab->cols);
+  /* the outer borders are set in the sentinels */
+  return test_bit (lab, LP_BOTTOM, r, c)
+         | test_bit (lab, LP_RIGHT, r, c) << 1
+         | test_bit (lab, LP_BOTTOM, r - 1, c) << 2
+         | test_bit (lab, LP_RIGHT, r, c - 1) << 3;
 }
 
 /* Add border flag. */
 void
 laby_add_border (Laby *lab, int y, int x, enum border border)
 {
-  lab->rooms[y][x] |= border;
-  /* also, we should set appropriate borders for neighbors */
+  /* upper and left borders are kept as borders of the neighbors */
   if (border & RIGHT_BORDER)
-    if (x < lab->cols - 1)
-      lab->rooms[y][x + 1] |= LEFT_BORDER;
+    set_bit (lab, LP_RIGHT, y, x);
   if (border & BOTTOM_BORDER)
-    if (y < lab->rows - 1)
-      lab->rooms[y + 1][x] |= UPPER_BORDER;
+    set_bit (lab, LP_BOTTOM, y, x);
   if (border & LEFT_BORDER)
-    if (x > 0)
-      lab->rooms[y][x - 1] |= RIGHT_BORDER;
+    set_bit (lab, LP_RIGHT, y, x - 1);
   if (border & UPPER_BORDER)
-    if (y > 0)
-      lab->rooms[y - 1][x] |= BOTTOM_BORDER;
+    set_bit (lab, LP_BOTTOM, y - 1, x);
 }
 
-/* Remove border flag. */
+/* Remove border flag. The outer borders of the labyrinth can't be removed. */
 void
 laby_rm_border (Laby *lab, int r, int c, enum border border)
 {
-  lab->rooms[r][c] &= ~border;
-  /* also, we should set appropriate borders for neighbors */
+  /* upper and left borders are kept as borders of the neighbors */
   if (border & RIGHT_BORDER)
     if (c < lab->cols - 1)
-      lab->rooms[r][c + 1] &= ~LEFT_BORDER;
+      clear_bit (lab, LP_RIGHT, r, c);
   if (border & BOTTOM_BORDER)
     if (r < lab->rows - 1)
-      lab->rooms[r + 1][c] &= ~UPPER_BORDER;
+      clear_bit (lab, LP_BOTTOM, r, c);
   if (border & LEFT_BORDER)
     if (c > 0)
-      lab->rooms[r][c - 1] &= ~RIGHT_BORDER;
+      clear_bit (lab, LP_RIGHT, r, c - 1);
   if (border & UPPER_BORDER)
     if (r > 0)
-      lab->rooms[r - 1][c] &= ~BOTTOM_BORDER;
+      clear_bit (lab, LP_BOTTOM, r - 1, c);
 }
 
 _Bool
 laby_is_visible (const Laby *lab, int r, int c)
 {
-  return (laby_is_inside (lab, r, c)) ? lab->rooms[r][c] & VISIBLE_MASK : 0;
+  /* sentinels are never visible */
+  return test_bit (lab, LP_VISIBLE, r, c);
 }
 
 void
@@ -129,46 +918,137 @@ laby_set_visibility (Laby *lab, int r, int c, _Bool flag)
   if (laby_is_inside (lab, r, c))
     {
       if (flag)
-        lab->rooms[r][c] |= (VISIBLE_MASK | KNOWN_MASK);
+        {
+          set_bit (lab, LP_VISIBLE, r, c);
+          set_bit (lab, LP_KNOWN, r, c);
+        }
       else
-        lab->rooms[r][c] &= ~VISIBLE_MASK;
+        clear_bit (lab, LP_VISIBLE, r, c);
     }
 }
 
 _Bool
 laby_is_known_room (const Laby *lab, int r, int c)
 {
-  return (laby_is_inside (lab, r, c)) ? lab->rooms[r][c] & KNOWN_MASK : 0;
+  /* sentinels are never known */
+  return test_bit (lab, LP_KNOWN, r, c);
 }
 
 void
 laby_mark_as_known_room (Laby *lab, int r, int c)
 {
   if (laby_is_inside (lab, r, c))
-    lab->rooms[r][c] |= KNOWN_MASK;
+    set_bit (lab, LP_KNOWN, r, c);
 }
 
 void
 laby_mark_whole_as_known (Laby *lab)
 {
-  for (int i = 0; i < lab->rows; i++)
-    for (int j = 0; j < lab->cols; j++)
+  laby_fill_rect (lab, LP_KNOWN, 0, 0, lab->rows, lab->cols, 1);
+}
+
+/**
+ * Crops the rectangle height x width with the upper left room r:c by the
+ * labyrinth, or by the rows of the ring. Returns 0 if nothing left.
+ */
+static _Bool
+crop_rect (const Laby *lab, int *r, int *c, int *height, int *width)
+{
+  int last = (lab->layout == LL_RING)
+                 ? min (lab->ring_first + LABY_RING_ROWS - 1, lab->rows)
+                 : lab->rows;
+  int r1 = min ((long)*r + *height, last);
+  int c1 = min (*c + *width, lab->cols);
+  *r = max (*r, lab->ring_first);
+  *c = max (*c, 0);
+  *height = r1 - *r;
+  *width = c1 - *c;
+  return *height > 0 && *width > 0;
+}
+
+void
+laby_fill_rect (Laby *lab, enum laby_plane p, int r, int c, int height,
+                int width, _Bool flag)
+{
+  if (!crop_rect (lab, &r, &c, &height, &width))
+    return;
+
+  fill_bits (lab, p, r, c, height, width, flag);
+
+  /* the outer borders of the labyrinth can't be removed */
+  if (!flag && p == LP_RIGHT && c + width == lab->cols)
+    fill_bits (lab, p, r, lab->cols - 1, height, 1, 1);
+  if (!flag && p == LP_BOTTOM && r + height == lab->rows)
+    fill_bits (lab, p, lab->rows - 1, c, 1, width, 1);
+}
+
+long
+laby_count_rect (const Laby *lab, enum laby_plane p, int r, int c,
+                 int height, int width)
+{
+  if (!crop_rect (lab, &r, &c, &height, &width))
+    return 0;
+
+  long pc0 = c + LABY_PAD;
+  long pc1 = c + width - 1 + LABY_PAD;
+  uint64_t first = ~(uint64_t)0 << tile_off (pc0);
+  uint64_t last = low_bits (tile_off (pc1) + 1);
+  long count = 0;
+  for (long pr = r + LABY_PAD; pr < r + height + LABY_PAD; pr++)
+    for (long w = tile_idx (pc0); w <= tile_idx (pc1); w++)
       {
-        lab->rooms[i][j] |= KNOWN_MASK;
+        uint64_t mask = ~(uint64_t)0;
+        if (w == tile_idx (pc0))
+          mask &= first;
+        if (w == tile_idx (pc1))
+          mask &= last;
+        count += __builtin_popcountll (*get_word (lab, p, pr, w << 6) & mask);
       }
+  return count;
+}
+
+uint64_t
+laby_get_bits (const Laby *lab, enum laby_plane p, int r, int c)
+{
+  assert (r >= 0 && r < lab->rows && c >= 0 && c < lab->cols);
+  return get_bits (lab, p, r, c);
 }
 
 void
 laby_set_content (Laby *lab, int y, int x, enum content value)
 {
-  int mask = (1 << CONTENT_SHIFT) - 1;
-  lab->rooms[y][x] = (value << CONTENT_SHIFT) | (lab->rooms[y][x] & mask);
+  int i = 0;
+  while (i < lab->content_count
+         && (lab->content[i].row != y || lab->content[i].col != x))
+    i++;
+
+  if (value == C_NOTHING)
+    {
+      /* remove the room from the list, if it is there */
+      if (i < lab->content_count)
+        lab->content[i] = lab->content[--lab->content_count];
+      return;
+    }
+
+  if (i == lab->content_count)
+    {
+      lab->content_count++;
+      lab->content = realloc (lab->content,
+                              sizeof (Laby_Content) * lab->content_count);
+      lab->content[i].row = y;
+      lab->content[i].col = x;
+    }
+  lab->content[i].content = value;
 }
 
 unsigned char
 laby_get_content (const Laby *lab, int r, int c)
 {
-  return lab->rooms[r][c] >> CONTENT_SHIFT;
+  for (int i = 0; i < lab->content_count; i++)
+    if (lab->content[i].row == r && lab->content[i].col == c)
+      return lab->content[i].content;
+
+  return C_NOTHING;
 }
 
 /**
@@ -269,6 +1149,10 @@ mark_visible_in_direction (Laby *lab, int r0, int c0, int r1, int c1)
           r0 = y / N;
           c0 = x / N;
 
+          /* the glance can't come back to the labyrinth */
+          if (!laby_is_inside (lab, r0, c0))
+            break;
+
           if (is_intersect_with_borders (lab, y0, x0, y, x))
             break;
 
@@ -327,60 +1211,483 @@ laby_mark_visible_rooms (Laby *lab, int r, int c, int range)
  * @see http://www.neocomputer.org/projects/eller.html
  */
 void
-laby_generate (Laby *lab, int height, int width, lcg *seed)
+laby_eller_init (Laby_Eller *eller, int width, lcg seed,
+                 enum laby_eller_version version)
 {
-  /* The final labyrinth */
-  laby_init_empty (lab, height, width);
-
-  /* Sets of rooms. The first one is a sets for the current row, the second is
-   * for the next row */
-  char *s = malloc (sizeof (char) * width);
-  char *_s = malloc (sizeof (char) * width);
+  eller->version = version;
+  eller->row = 0;
+  eller->width = width;
+  eller->sets = malloc (sizeof (int) * width);
+  eller->tmp = malloc (sizeof (int) * width);
+  eller->left = calloc (2 * width, sizeof (int));
+  eller->free_sets = malloc (sizeof (int) * 2 * width);
+  eller->seed = seed;
 
-  int set = 1;
   /* set unique set for every empty room in the first row */
   for (int j = 0; j < width; j++)
-    _s[j] = set++;
+    eller->sets[j] = j;
+}
+
+/* Mixes bits of the number by the finalizer of splitmix64 */
+static inline uint64_t
+mix_bits (uint64_t z)
+{
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+  return z ^ (z >> 31);
+}
+
+/* Returns 64 random bits by the splitmix64 generator (LEV_2) */
+static inline uint64_t
+random_bits (lcg *state)
+{
+  return mix_bits (*state += 0x9e3779b97f4a7c15);
+}
+
+/**
+ * Returns 64 random bits, every of which is set with the chance 205/256
+ * (~4/5). Random words are combined from the lowest bit of the chance
+ * 0.11001101b: `or` for 1, `and` for 0.
+ */
+static inline uint64_t
+random_biased_bits (lcg *state)
+{
+  const unsigned chance = 205;
+  uint64_t bits = random_bits (state);
+  for (int i = 1; i < 8; i++)
+    bits = ((chance >> i) & 1) ? bits | random_bits (state)
+                               : bits & random_bits (state);
+  return bits;
+}
+
+void
+laby_eller_next_row (Laby_Eller *eller, Laby *lab)
+{
+  int y = eller->row++;
+  int width = eller->width;
+  lcg *seed = &eller->seed;
+  int *left = eller->left;
+  int *free_sets = eller->free_sets;
+  _Bool batched = eller->version == LEV_2;
+  uint64_t bits = 0;
+
+  /* the ring should keep the current row and the next one */
+  if (lab->layout == LL_RING && y + 1 > lab->ring_first + LABY_RING_ROWS - 2)
+    laby_ring_shift (lab, y + 3 - LABY_RING_ROWS);
+
+  /* swap sets to use `s` for the current row */
+  int *s = eller->sets;
+  int *_s = eller->tmp;
+  eller->sets = _s;
+  eller->tmp = s;
+
+  /* decide if two rooms should have a horizontal border */
+  for (int x = 0; x < width - 1; x++)
+    {
+      if (batched && tile_off (x) == 0)
+        bits = random_bits (seed);
+      if (s[x] != s[x + 1]
+          && (batched ? (bits >> tile_off (x)) & 1
+                      : lcg_rand (seed) % 2 == 0))
+        laby_add_border (lab, y, x, RIGHT_BORDER);
+      else
+        s[x + 1] = s[x];
+    }
+
+  /* count rooms of every set, all of them are without bottom border yet */
+  for (int x = 0; x < width; x++)
+    left[s[x]]++;
+  /* the sets, which are not used in the row, are free for the new rooms */
+  int free_count = 0;
+  for (int i = 2 * width - 1; i >= 0; i--)
+    if (left[i] == 0)
+      free_sets[free_count++] = i;
+
+  /* decide if two rooms should have a vertical border */
+  for (int x = 0; x < width; x++)
+    {
+      if (batched && tile_off (x) == 0)
+        bits = random_biased_bits (seed);
+      /* we can create a border, if it's not a single room without bottom
+       * border in the set */
+      if (left[s[x]] > 1
+          && (batched ? (bits >> tile_off (x)) & 1
+                      : lcg_rand (seed) % 5 > 0))
+        {
+          laby_add_border (lab, y, x, BOTTOM_BORDER);
+          left[s[x]]--;
+          /* mark the underlining room to change its set */
+          _s[x] = free_sets[--free_count];
+        }
+      else
+        _s[x] = s[x];
+    }
+
+  /* reset counters for the next row */
+  for (int x = 0; x < width; x++)
+    left[s[x]] = 0;
+}
+
+void
+laby_eller_free (Laby_Eller *eller)
+{
+  free (eller->sets);
+  free (eller->tmp);
+  free (eller->left);
+  free (eller->free_sets);
+  eller->sets = NULL;
+  eller->tmp = NULL;
+  eller->left = NULL;
+  eller->free_sets = NULL;
+}
+
+void
+laby_generate_eller (Laby *lab, lcg *seed)
+{
+  laby_generate_eller_version (lab, seed, LEV_1);
+}
+
+void
+laby_generate_eller_version (Laby *lab, lcg *seed,
+                             enum laby_eller_version version)
+{
+  Laby_Eller eller;
+  laby_eller_init (&eller, lab->cols, *seed, version);
+  while (eller.row < lab->rows - 1)
+    laby_eller_next_row (&eller, lab);
+
+  /* remove dead ends */
+  for (int x = 0; x < lab->cols - 1; x++)
+    laby_rm_border (lab, lab->rows - 1, x, RIGHT_BORDER);
+
+  *seed = eller.seed;
+  laby_eller_free (&eller);
+}
+
+/* The index of the value of the lane k for the item i */
+#define lane_idx(i, k) ((long)(i)*LABY_BATCH_LANES + (k))
+
+void
+laby_generate_batch (Laby_Batch *batch, int height, int width, lcg *seeds)
+{
+  const int n = LABY_BATCH_LANES;
+  batch->rows = height;
+  batch->cols = width;
+  batch->right = malloc (sizeof (uint64_t) * height * width);
+  batch->bottom = malloc (sizeof (uint64_t) * height * width);
+
+  /* the state of laby_eller_next_row for every lane. The values of all
+   * lanes for one room are neighbors in memory */
+  int *s = malloc (sizeof (int) * n * width);
+  int *_s = malloc (sizeof (int) * n * width);
+  int *left = calloc ((long)n * 2 * width, sizeof (int));
+  int *free_sets = malloc (sizeof (int) * n * 2 * width);
+  int free_count[LABY_BATCH_LANES];
+
+  for (int x = 0; x < width; x++)
+    for (int k = 0; k < n; k++)
+      s[lane_idx (x, k)] = x;
 
   for (int y = 0; y < height - 1; y++)
     {
-      /* swap sets to use `s` for the current row */
-      char *tmp = s;
+      uint64_t *right = batch->right + (long)y * width;
+      uint64_t *bottom = batch->bottom + (long)y * width;
+
+      /* the same decisions as in laby_eller_next_row with LEV_1 */
+      for (int x = 0; x < width - 1; x++)
+        {
+          uint64_t borders = 0;
+          int *a = s + lane_idx (x, 0);
+          int *b = s + lane_idx (x + 1, 0);
+          for (int k = 0; k < n; k++)
+            if (a[k] != b[k] && lcg_rand (&seeds[k]) % 2 == 0)
+              borders |= (uint64_t)1 << k;
+            else
+              b[k] = a[k];
+          right[x] = borders;
+        }
+      right[width - 1] = ~(uint64_t)0;
+
+      for (int x = 0; x < width; x++)
+        for (int k = 0; k < n; k++)
+          left[lane_idx (s[lane_idx (x, k)], k)]++;
+      for (int k = 0; k < n; k++)
+        free_count[k] = 0;
+      for (int i = 2 * width - 1; i >= 0; i--)
+        for (int k = 0; k < n; k++)
+          if (left[lane_idx (i, k)] == 0)
+            free_sets[lane_idx (free_count[k]++, k)] = i;
+
+      for (int x = 0; x < width; x++)
+        {
+          uint64_t borders = 0;
+          for (int k = 0; k < n; k++)
+            {
+              int set = s[lane_idx (x, k)];
+              if (left[lane_idx (set, k)] > 1
+                  && lcg_rand (&seeds[k]) % 5 > 0)
+                {
+                  borders |= (uint64_t)1 << k;
+                  left[lane_idx (set, k)]--;
+                  _s[lane_idx (x, k)]
+                      = free_sets[lane_idx (--free_count[k], k)];
+                }
+              else
+                _s[lane_idx (x, k)] = set;
+            }
+          bottom[x] = borders;
+        }
+
+      for (int x = 0; x < width; x++)
+        for (int k = 0; k < n; k++)
+          left[lane_idx (s[lane_idx (x, k)], k)] = 0;
+
+      int *tmp = s;
       s = _s;
       _s = tmp;
+    }
+
+  /* the last row is without dead ends, as in laby_generate_eller */
+  uint64_t *right = batch->right + (long)(height - 1) * width;
+  uint64_t *bottom = batch->bottom + (long)(height - 1) * width;
+  for (int x = 0; x < width; x++)
+    {
+      right[x] = (x == width - 1) ? ~(uint64_t)0 : 0;
+      bottom[x] = ~(uint64_t)0;
+    }
+
+  free (s);
+  free (_s);
+  free (left);
+  free (free_sets);
+}
+
+void
+laby_batch_unpack (const Laby_Batch *batch, int k, Laby *lab)
+{
+  laby_init_empty (lab, batch->rows, batch->cols);
+  for (int r = 0; r < batch->rows; r++)
+    for (int c = 0; c < batch->cols; c++)
+      {
+        long i = (long)r * batch->cols + c;
+        if ((batch->right[i] >> k) & 1)
+          set_bit (lab, LP_RIGHT, r, c);
+        if ((batch->bottom[i] >> k) & 1)
+          set_bit (lab, LP_BOTTOM, r, c);
+      }
+}
+
+void
+laby_batch_free (Laby_Batch *batch)
+{
+  free (batch->right);
+  free (batch->bottom);
+  batch->right = NULL;
+  batch->bottom = NULL;
+}
+
+/* Returns the root of the set with path halving */
+static inline int
+find_set (int *parent, int set)
+{
+  while (parent[set] != set)
+    set = parent[set] = parent[parent[set]];
+  return set;
+}
+
+/**
+ * Generates the rows from..to-1 as a separate perfect labyrinth by the
+ * Eller's algorithm. Unlike laby_eller_next_row, joined sets are merged, so
+ * the rooms of one set are never joined twice. The last row is closed by
+ * bottom borders.
+ */
+static void
+generate_perfect_rows (Laby *lab, int from, int to, lcg *seed)
+{
+  int width = lab->cols;
+  int *s = malloc (sizeof (int) * width);
+  int *_s = malloc (sizeof (int) * width);
+  /* the sets are numbers less than 2 x width, as in laby_eller_next_row */
+  int *parent = malloc (sizeof (int) * 2 * width);
+  int *left = calloc (2 * width, sizeof (int));
+  int *free_sets = malloc (sizeof (int) * 2 * width);
+
+  for (int x = 0; x < width; x++)
+    s[x] = parent[x] = x;
 
-      /* decide if two rooms should have a horizontal border */
+  for (int y = from; y < to; y++)
+    {
+      _Bool last = y == to - 1;
+      /* decide if two rooms should have a horizontal border. The rooms of
+       * different sets are always joined in the last row */
       for (int x = 0; x < width - 1; x++)
         {
-          if (s[x] != s[x + 1] && lcg_rand (seed) % 2 == 0)
+          int a = find_set (parent, s[x]);
+          int b = find_set (parent, s[x + 1]);
+          if (a == b || (!last && lcg_rand (seed) % 2 == 0))
             laby_add_border (lab, y, x, RIGHT_BORDER);
           else
-            s[x + 1] = s[x];
+            parent[b] = a;
+        }
+      if (last)
+        {
+          fill_bits (lab, LP_BOTTOM, y, 0, 1, width, 1);
+          break;
+        }
+
+      /* count rooms of every set */
+      for (int x = 0; x < width; x++)
+        {
+          s[x] = find_set (parent, s[x]);
+          left[s[x]]++;
         }
+      int free_count = 0;
+      for (int i = 2 * width - 1; i >= 0; i--)
+        if (left[i] == 0)
+          free_sets[free_count++] = i;
+
       /* decide if two rooms should have a vertical border */
       for (int x = 0; x < width; x++)
         {
-          /* count of rooms without bottom border in the current set */
-          int no_bb = 0;
-          for (int i = 0; i < width && no_bb < 2; i++)
-            if (s[x] == s[i])
-              no_bb = (laby_get_borders (lab, y, i) & BOTTOM_BORDER)
-                          ? no_bb
-                          : no_bb + 1;
-
-          /* we can create a border, if it's not a single room without bottom
-           * border in the set */
-          if (no_bb > 1 && lcg_rand (seed) % 5 > 0)
+          if (left[s[x]] > 1 && lcg_rand (seed) % 5 > 0)
             {
               laby_add_border (lab, y, x, BOTTOM_BORDER);
-              /* mark the underlining room to change its set */
-              _s[x] = set++;
+              left[s[x]]--;
+              _s[x] = free_sets[--free_count];
+              parent[_s[x]] = _s[x];
             }
           else
             _s[x] = s[x];
         }
+      for (int x = 0; x < width; x++)
+        left[s[x]] = 0;
+
+      int *tmp = s;
+      s = _s;
+      _s = tmp;
     }
-  /* remove dead ends */
-  for (int x = 0; x < width - 1; x++)
-    laby_rm_border (lab, height - 1, x, RIGHT_BORDER);
+
+  free (s);
+  free (_s);
+  free (parent);
+  free (left);
+  free (free_sets);
+}
+
+/* The rows generated by one thread */
+typedef struct
+{
+  Laby *lab;
+  int from;
+  int to;
+  lcg seed;
+} Laby_Strip;
+
+static void *
+generate_strip (void *arg)
+{
+  Laby_Strip *strip = arg;
+  generate_perfect_rows (strip->lab, strip->from, strip->to, &strip->seed);
+  return NULL;
+}
+
+void
+laby_generate_parallel (Laby *lab, lcg *seed, int threads)
+{
+  assert (lab->layout != LL_RING);
+  threads = max (1, min (threads, lab->rows));
+
+  Laby_Strip *strips = malloc (sizeof (Laby_Strip) * threads);
+  pthread_t *ids = malloc (sizeof (pthread_t) * threads);
+  for (int i = 0; i < threads; i++)
+    {
+      strips[i].lab = lab;
+      strips[i].from = (long)lab->rows * i / threads;
+      strips[i].to = (long)lab->rows * (i + 1) / threads;
+      /* every row takes not more than 2 x cols - 1 random numbers, so the
+       * strips take disjoint parts of the sequence of the seed */
+      uint64_t numbers = (uint64_t)(strips[i].to - strips[i].from)
+                         * (2 * lab->cols - 1);
+      strips[i].seed = lcg_split (seed, numbers);
+    }
+
+  /* the tiles are allocated on write, so they can't be shared by threads */
+  if (lab->layout == LL_TILES)
+    for (int i = 0; i < threads; i++)
+      generate_strip (&strips[i]);
+  else
+    {
+      for (int i = 1; i < threads; i++)
+        pthread_create (&ids[i], NULL, generate_strip, &strips[i]);
+      generate_strip (&strips[0]);
+      for (int i = 1; i < threads; i++)
+        pthread_join (ids[i], NULL);
+    }
+
+  /* the single passage between neighbor strips keeps the labyrinth perfect */
+  for (int i = 1; i < threads; i++)
+    laby_rm_border (lab, strips[i].from - 1, lcg_rand (seed) % lab->cols,
+                    BOTTOM_BORDER);
+
+  free (strips);
+  free (ids);
+}
+
+/* The kinds of random numbers of the chunk */
+enum chunk_hash_kind
+{
+  /* The row of the passage through the right border */
+  CHK_RIGHT_PASSAGE,
+  /* The column of the passage through the bottom border */
+  CHK_BOTTOM_PASSAGE,
+  /* The seed of the rooms inside the chunk */
+  CHK_ROOMS
+};
+
+/**
+ * Returns random bits, which depend only on the arguments. Unlike lcg_rand,
+ * any number can be taken without the previous ones.
+ */
+static uint64_t
+chunk_hash (lcg seed, long chunk_row, long chunk_col,
+            enum chunk_hash_kind kind)
+{
+  uint64_t z = mix_bits (seed + 0x9e3779b97f4a7c15 * (kind + 1));
+  z = mix_bits (z ^ (uint64_t)chunk_row);
+  return mix_bits ((z + 0x9e3779b97f4a7c15) ^ (uint64_t)chunk_col);
+}
+
+void
+laby_generate_chunk (Laby *lab, lcg seed, long chunk_row, long chunk_col)
+{
+  const int side = LABY_CHUNK_SIDE;
+  laby_init (lab, side, side, LL_ROWS);
+
+  /* lcg_rand never leaves the zero state */
+  lcg rooms_seed
+      = 1 + chunk_hash (seed, chunk_row, chunk_col, CHK_ROOMS)
+                % (LCG_MODULUS - 1);
+  generate_perfect_rows (lab, 0, side, &rooms_seed);
+
+  /* the left and upper passages are the passages of the neighbors */
+  int right = chunk_hash (seed, chunk_row, chunk_col, CHK_RIGHT_PASSAGE)
+              % side;
+  int left = chunk_hash (seed, chunk_row, chunk_col - 1, CHK_RIGHT_PASSAGE)
+             % side;
+  int bottom = chunk_hash (seed, chunk_row, chunk_col, CHK_BOTTOM_PASSAGE)
+               % side;
+  int upper = chunk_hash (seed, chunk_row - 1, chunk_col, CHK_BOTTOM_PASSAGE)
+              % side;
+  /* laby_rm_border keeps the outer borders */
+  clear_bit (lab, LP_RIGHT, right, side - 1);
+  clear_bit (lab, LP_RIGHT, left, -1);
+  clear_bit (lab, LP_BOTTOM, side - 1, bottom);
+  clear_bit (lab, LP_BOTTOM, -1, upper);
+}
+
+void
+laby_generate (Laby *lab, int height, int width, lcg *seed)
+{
+  laby_init_empty (lab, height, width);
+  laby_generate_eller (lab, seed);
 }
@@ -4,23 +4,49 @@
 #include "2d_math.h"
 #include "lcg.h"
 
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
 /*
- * All information about a single room should be encoded in one byte:
+ * Information about rooms is kept in the bit planes, one bit per room in
+ * every plane (see enum laby_plane). Only right and bottom borders are
+ * stored. The upper and left borders of the room are the bottom border of
+ * the upper room and the right border of the left room.
  *
- * |   C   |N|V|L U R B|
- * |0 ... 0|0|0|0 0 0 0|
+ * 64 neighbor rooms of one row are described by LP_COUNT neighbor words,
+ * one word per plane:
+ *
+ * |  word 0  |  word 1  |  word 2  |  word 3  |  word 4  | ...
+ * | R 0...63 | B 0...63 | V 0...63 | N 0...63 | R 64...  | ...
  *
- * Section B: describes the bottom border of the room;
  * Section R: describes the right border of the room;
- * Section U: describes the upper border of the room;
- * Section L: describes the left border of the room;
+ * Section B: describes the bottom border of the room;
  * Section V: is the room visible or not;
  * Section N: was the room visible by the player or not;
- * Section C: describes a content of the room;
+ *
+ * The labyrinth is surrounded by the ring of sentinel rooms with preset
+ * borders, so the borders of the rooms on the edge, and of the rooms just
+ * outside the labyrinth, are read without any bounds checks. Two sentinel
+ * rows and columns are placed before the labyrinth, because the upper border
+ * of the room in the row -1 is the bottom border of the room in the row -2.
+ *
+ * The words are kept in memory according to the layout of the labyrinth (see
+ * enum laby_layout). Rows of the giant labyrinth are split to square tiles,
+ * which are allocated only on the first write. Only the last rows of the
+ * endless labyrinth are kept in the ring buffer.
+ *
+ * The rooms with some content are kept apart in the short list.
  */
-typedef unsigned int room;
-
-typedef room *p_room;
+enum laby_plane
+{
+  LP_RIGHT,
+  LP_BOTTOM,
+  LP_VISIBLE,
+  LP_KNOWN,
+  /* The count of planes */
+  LP_COUNT
+};
 
 /**
  * Checks the flag `expected` in the `border` and returns TRUE
@@ -49,10 +75,56 @@ enum content
   C_NOTHING = 0,
   C_PLAYER = 1,
   C_EXIT = 2,
+  /* The room of the path to the exit shown by the hint */
+  C_HINT = 3,
+};
+
+/* The room with some content */
+typedef struct
+{
+  int row;
+  int col;
+  enum content content;
+} Laby_Content;
+
+/* The ways to keep bit planes of the labyrinth in memory */
+enum laby_layout
+{
+  /* All rows of the labyrinth in the single block */
+  LL_ROWS,
+  /* Square tiles of rooms, which are allocated on the first write */
+  LL_TILES,
+  /* All square tiles of rooms in the single block, row by row */
+  LL_BLOCKS,
+  /* All square tiles of rooms in the single block, in the Z-order (Morton
+   * order) of their positions, so tiles close by vertical are close in
+   * memory too */
+  LL_MORTON,
+  /* The ring buffer of the last LABY_RING_ROWS rows of the endless
+   * labyrinth. The rows out of the ring are lost */
+  LL_RING
 };
 
-/* The single horizontal line of rooms. */
-typedef room *row;
+/* The count of rooms by one side of the tile */
+#define LABY_TILE_SIDE 64
+
+/* The count of tiles by one side of the page of the tiles directory */
+#define LABY_PAGE_SIDE 64
+
+/* The count of words in one tile: LP_COUNT words for every row */
+#define LABY_TILE_WORDS (LABY_TILE_SIDE * LP_COUNT)
+
+/* The labyrinth with more rooms than this is kept in tiles */
+#define LABY_MAX_ROWS_LAYOUT_ROOMS (1L << 30)
+
+/* The count of padded rows in the ring buffer. Must be a power of two. */
+#define LABY_RING_ROWS 64
+
+/* The count of rooms by one side of the chunk of the unbounded labyrinth */
+#define LABY_CHUNK_SIDE 64
+
+/* The count of rows of the endless labyrinth */
+#define LABY_ENDLESS_ROWS 0x7fffff00
 
 /* The structure described a labyrinth */
 typedef struct
@@ -63,22 +135,288 @@ typedef struct
   /* The count of rooms by vertical */
   int rows;
 
-  /* The rows of the labyrinth's rooms */
-  row *rooms;
+  enum laby_layout layout;
+
+  /* The mapped file with the words of the labyrinth (see laby_open_file), or
+   * NULL if the words are allocated in memory */
+  void *map;
+  size_t map_size;
+
+  /* LL_ROWS, LL_RING: the count of words of a single plane in one row */
+  int stride;
+
+  /* LL_ROWS, LL_RING: the mask of the padded row to get the row of the block
+   * of words */
+  long rows_mask;
+
+  /* LL_RING: the first row of the labyrinth which is kept in the ring. The
+   * ring keeps the rows from ring_first - 1 to
+   * ring_first + LABY_RING_ROWS - 2. It's 0 for other layouts. */
+  int ring_first;
+
+  /* LL_ROWS: bit planes of all rooms as a single row-major block;
+   * LL_RING: the same, but only for LABY_RING_ROWS rows;
+   * LL_BLOCKS, LL_MORTON: the single block with all tiles */
+  uint64_t *words;
+
+  /* The count of pages of the tiles directory by horizontal */
+  int pages_cols;
+
+  /* The directory of tiles for tiled layouts. Every page is a
+   * row-major square of LABY_PAGE_SIDE x LABY_PAGE_SIDE pointers to tiles.
+   * A page is allocated on the first write to one of its tiles, not
+   * allocated page is NULL. */
+  uint64_t ***pages;
+
+  /* Shared read-only tiles with sentinels only, which are used instead of
+   * not allocated tiles (see tile_template in laby.c) */
+  uint64_t *templates;
+
+  /* The count of allocated pages and tiles */
+  long pages_count;
+  long tiles_count;
+
+  /* The count of rooms with some content */
+  int content_count;
+
+  /* The rooms with some content */
+  Laby_Content *content;
 } Laby;
 
+/* The count of sentinel rows (columns) before the first row (column) */
+#define LABY_PAD 2
+
+/* The count of sentinel rows (columns) after the last row (column) */
+#define LABY_PAD_END 1
+
+/**
+ * Versions of the stream of random decisions of the Eller's algorithm.
+ * The same seed gives the same labyrinth only in the same version.
+ */
+enum laby_eller_version
+{
+  /* One lcg_rand per decision, which is taken only when it's needed */
+  LEV_1 = 1,
+  /* Batched random bits: 64 decisions about right borders per one random
+   * word, and 64 decisions about bottom borders with the chance 205/256 per
+   * 8 random words. Every row takes the same count of random words. */
+  LEV_2 = 2
+};
+
+/* The state of the Eller's algorithm between two rows */
+typedef struct
+{
+  enum laby_eller_version version;
+
+  /* The row, which will be generated on the next step */
+  int row;
+
+  /* The count of rooms in the row */
+  int width;
+
+  /* Sets of rooms of the next row. A set is a number less than
+   * 2 x width, numbers of sets, which are not used anymore, are reused */
+  int *sets;
+
+  /* The buffer for the sets of the current row */
+  int *tmp;
+
+  /* The counts of rooms without bottom border in every set of the current
+   * row, and the stack of not used sets */
+  int *left;
+  int *free_sets;
+
+  /* The own seed of the generator, so the labyrinth doesn't depend on other
+   * usages of random numbers. LEV_2 uses it as the state of splitmix64. */
+  lcg seed;
+} Laby_Eller;
+
 #define laby_is_inside(lab, r, c)                                             \
-  (c >= 0 && c < lab->cols && r >= 0 && r < lab->rows)
+  ((unsigned)(c) < (unsigned)(lab)->cols                                      \
+   && (unsigned)(r) < (unsigned)(lab)->rows)
 
-/* Creates a new labyrinth with height x width empty rooms. */
+/**
+ * Creates a new labyrinth with height x width empty rooms.
+ * The layout is chosen according to the size of the labyrinth.
+ */
 void laby_init_empty (Laby *lab, int height, int width);
 
+/* Creates a new labyrinth with height x width empty rooms in the layout. */
+void laby_init (Laby *lab, int height, int width, enum laby_layout layout);
+
+/* Creates and generates a new labyrinth with height x width rooms. */
 void laby_generate (Laby *lab, int height, int width, lcg *seed);
 
+/* Generates borders in the empty labyrinth by the Eller's algorithm. */
+void laby_generate_eller (Laby *lab, lcg *seed);
+
+/* The same as laby_generate_eller, but with the version of the random
+ * decisions. laby_generate_eller uses LEV_1. */
+void laby_generate_eller_version (Laby *lab, lcg *seed,
+                                  enum laby_eller_version version);
+
+/* The count of labyrinths generated at once by laby_generate_batch */
+#define LABY_BATCH_LANES 64
+
+/**
+ * LABY_BATCH_LANES labyrinths of the same size. Every word is about one
+ * room of all labyrinths: the bit k is about the labyrinth k. It takes 2 bits
+ * per room of every labyrinth, as Laby does.
+ */
+typedef struct
+{
+  int rows;
+  int cols;
+  /* rows x cols words with right borders of the rooms */
+  uint64_t *right;
+  /* rows x cols words with bottom borders of the rooms */
+  uint64_t *bottom;
+} Laby_Batch;
+
+/**
+ * Generates LABY_BATCH_LANES labyrinths of height x width rooms in one pass.
+ * The labyrinth k is the same as laby_generate makes for seeds[k], and
+ * seeds[k] is changed in the same way too. Every labyrinth takes its own
+ * count of random numbers, so the lanes are computed one by one for every
+ * room, with the states of all lanes next to each other in memory.
+ */
+void laby_generate_batch (Laby_Batch *batch, int height, int width,
+                          lcg *seeds);
+
+/* Creates a new labyrinth with the borders of the labyrinth k. */
+void laby_batch_unpack (const Laby_Batch *batch, int k, Laby *lab);
+
+void laby_batch_free (Laby_Batch *batch);
+
+/**
+ * Generates a perfect labyrinth (every room is reachable by the single
+ * path) in the empty labyrinth on a few threads. The labyrinth is split to
+ * horizontal strips, one per thread, every strip is generated by the
+ * Eller's algorithm as a separate perfect labyrinth, then neighbor strips
+ * are joined by a single passage. Every strip takes its own part of the
+ * sequence of random numbers of the seed (see lcg_split), so the result
+ * depends only on the seed and the count of threads. The strips of the
+ * LL_TILES labyrinth are generated one by one, because its tiles are
+ * allocated on write. The LL_RING labyrinth is not supported.
+ */
+void laby_generate_parallel (Laby *lab, lcg *seed, int threads);
+
+/**
+ * Generates the chunk chunk_row:chunk_col of the unbounded labyrinth as
+ * a new labyrinth of LABY_CHUNK_SIDE x LABY_CHUNK_SIDE rooms. The chunk
+ * depends only on the seed and its coordinates, so chunks can be generated
+ * in any order and freed when they are not needed anymore.
+ *
+ * Every chunk is a perfect labyrinth, which has a single passage through
+ * every of its four outer borders. The passages are the same for both
+ * neighbor chunks, so the whole unbounded labyrinth is connected.
+ */
+void laby_generate_chunk (Laby *lab, lcg seed, long chunk_row,
+                          long chunk_col);
+
+/* Prepares the Eller's algorithm to generate rows of width rooms. */
+void laby_eller_init (Laby_Eller *eller, int width, lcg seed,
+                      enum laby_eller_version version);
+
+/**
+ * Generates borders of the next row of the labyrinth. Only the sets of the
+ * current row are needed, so the labyrinth can be generated row by row while
+ * the player goes down. The ring of the LL_RING labyrinth is shifted to keep
+ * the generated row and the next one.
+ */
+void laby_eller_next_row (Laby_Eller *eller, Laby *lab);
+
+void laby_eller_free (Laby_Eller *eller);
+
+/**
+ * Shifts the ring of the LL_RING labyrinth down to keep rows from
+ * first_row - 1. The rows new in the ring are empty.
+ */
+void laby_ring_shift (Laby *lab, int first_row);
+
 /* Frees memory of the labyrinth. */
 void laby_free (Laby *lab);
 
-/*  Returns only 4 first bits, which are about borders of the room. */
+/* Returns the count of bytes allocated for the rooms of the labyrinth. */
+size_t laby_memory_usage (const Laby *lab);
+
+/**
+ * Saves the labyrinth to the file. The file has a header with the size of
+ * the labyrinth, the seed and the version of the format, then the words of
+ * all rooms in the LL_ROWS layout. The content of rooms is not saved.
+ * Returns 0 on success, or -1 and sets errno on error.
+ */
+int laby_save_file (const Laby *lab, lcg seed, const char *path);
+
+/**
+ * Generates the labyrinth as laby_generate does, and writes it to the file
+ * in the format of laby_save_file. Every row is written right after it's
+ * generated, and only the ring of the last rows is kept in memory, so the
+ * memory doesn't depend on the count of rows. The seed in the file is the
+ * initial one, and @seed is set to the state after the generation.
+ * Returns 0 on success, or -1 and sets errno on error.
+ */
+int laby_generate_file (int height, int width, lcg *seed, const char *path);
+
+/**
+ * Opens the labyrinth saved by laby_save_file. The file is mapped to memory
+ * instead of reading, so only pages with the touched rooms are read from
+ * the disk. The mapping is copy-on-write: changes of the labyrinth are not
+ * written to the file.
+ * @seed is set to the seed from the file, if it's not NULL.
+ * Returns 0 on success, or -1 and sets errno on error.
+ */
+int laby_open_file (Laby *lab, lcg *seed, const char *path);
+
+/**
+ * Returns the count of words taken by borders of the labyrinth packed by
+ * laby_pack_borders.
+ */
+size_t laby_packed_words (int rows, int cols);
+
+/**
+ * Packs right and bottom borders of the labyrinth to the words: 2 bits per
+ * room, row by row, without sentinels. The content, known and visible rooms
+ * are not packed. The LL_RING labyrinth can't be packed.
+ */
+void laby_pack_borders (const Laby *lab, uint64_t *words);
+
+/**
+ * Packs borders of the row r as laby_pack_borders does, to
+ * laby_packed_words (1, cols) words.
+ */
+void laby_pack_row (const Laby *lab, int r, uint64_t *words);
+
+/**
+ * Initializes the labyrinth with borders packed by laby_pack_borders. The
+ * layout is chosen according to the size of the labyrinth.
+ */
+void laby_unpack_borders (Laby *lab, int rows, int cols,
+                          const uint64_t *words);
+
+/**
+ * Writes the labyrinth to the stream in the compact form: right and bottom
+ * borders of every row (2 bits per room), the run-length encoded bitmap of
+ * known rooms and the list of rooms with content. The visibility is not
+ * written. The stream is written row by row without a copy of the
+ * labyrinth. The LL_RING labyrinth can't be written.
+ * Returns 0 on success, or -1 on error.
+ */
+int laby_write (const Laby *lab, FILE *f);
+
+/**
+ * Reads the labyrinth written by laby_write. The layout is chosen according
+ * to the size of the labyrinth.
+ * Returns 0 on success, or -1 on error. The labyrinth is not initialized on
+ * error.
+ */
+int laby_read (Laby *lab, FILE *f);
+
+/**
+ *  Returns only 4 first bits, which are about borders of the room.
+ *  The room must be inside the labyrinth or right around it:
+ *  -1 <= y <= rows, -1 <= x <= cols.
+ */
 unsigned char laby_get_borders (const Laby *lab, int y, int x);
 
 /* Add border flag. */
@@ -103,16 +441,43 @@ void laby_rm_border (Laby *lab, int y, int x, enum border border);
  */
 void laby_mark_visible_rooms (Laby *lab, int r, int c, int range);
 
+/* The same as for laby_get_borders, the room must be inside the labyrinth or
+ * right around it. */
 _Bool laby_is_visible (const Laby *lab, int r, int c);
 
 void laby_set_visibility (Laby *lab, int r, int c, _Bool flag);
 
+/* The same as for laby_get_borders, the room must be inside the labyrinth or
+ * right around it. */
 _Bool laby_is_known_room (const Laby *lab, int r, int c);
 
 void laby_mark_as_known_room (Laby *lab, int r, int c);
 
 void laby_mark_whole_as_known (Laby *lab);
 
+/**
+ * Sets (flag is 1) or clears (flag is 0) bits of the plane p for all rooms in
+ * the rectangle height x width with the upper left room r:c. The rectangle is
+ * cropped by the labyrinth. 64 rooms of a row are changed at once.
+ */
+void laby_fill_rect (Laby *lab, enum laby_plane p, int r, int c, int height,
+                     int width, _Bool flag);
+
+/**
+ * Returns the count of rooms with set bit of the plane p in the rectangle
+ * height x width with the upper left room r:c. The rectangle is cropped by the
+ * labyrinth.
+ */
+long laby_count_rect (const Laby *lab, enum laby_plane p, int r, int c,
+                      int height, int width);
+
+/**
+ * Returns 64 bits of the plane p for the rooms r:c...r:c+63. The room r:c
+ * must be inside the labyrinth, the bits after the last room of the row are
+ * undefined.
+ */
+uint64_t laby_get_bits (const Laby *lab, enum laby_plane p, int r, int c);
+
 void laby_set_content (Laby *lab, int r, int c, enum content value);
 
 unsigned char laby_get_content (const Laby *lab, int r, int c);
@@ -0,0 +1,338 @@
+/**
+ * The breadth-first search in the labyrinth over bitsets of 8x8 rooms.
+ * A corridor stays in the same block for a few steps in every direction, so
+ * the most of moves don't touch new cache lines.
+ */
+#include "laby_bfs.h"
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The rooms of the first (last) column and row of the block */
+#define COL_FIRST LABY_BFS_COL_FIRST
+#define COL_LAST (COL_FIRST << 7)
+#define ROW_FIRST 0xff
+#define ROW_LAST ((uint64_t)ROW_FIRST << 56)
+/* The rooms of sides of the block */
+#define SIDES (COL_FIRST | COL_LAST | ROW_FIRST | ROW_LAST)
+
+/* Returns the index of the lowest room of `rooms` from sides of the block
+ * in steps of Laby_Bfs_Entries, which is the count of side rooms before it */
+#define side_index(rooms) __builtin_popcountll (SIDES & ~(rooms) & ((rooms)-1))
+
+int
+laby_bfs_init (Laby_Bfs *bfs, const Laby *lab, _Bool distances)
+{
+  assert (lab->layout != LL_RING);
+  bfs->rows = lab->rows;
+  bfs->cols = lab->cols;
+  bfs->blocks_cols = (lab->cols + 7) / 8;
+  bfs->blocks_count = (lab->rows + 7) / 8 * bfs->blocks_cols;
+  /* the row of visited guard blocks before and after the labyrinth lets
+   * moves to not check sides; two blocks are in one cache line */
+  long guard = (bfs->blocks_cols + 2) / 2 * 2;
+  /* the size of the aligned memory must be a multiple of the alignment */
+  size_t align = 2 * sizeof (Laby_Bfs_Block);
+  size_t size = sizeof (Laby_Bfs_Block) * (bfs->blocks_count + 2 * guard);
+  size = (size + align - 1) / align * align;
+  bfs->memory = aligned_alloc (align, size);
+  bfs->front = malloc (sizeof (Laby_Bfs_Front) * bfs->blocks_count);
+  /* the lists have the place for the index after the last one */
+  bfs->next = malloc (sizeof (long) * (bfs->blocks_count + 1));
+  bfs->touched = malloc (sizeof (long) * (bfs->blocks_count + 1));
+  bfs->entries = distances
+                     ? calloc (bfs->blocks_count, sizeof (Laby_Bfs_Entries))
+                     : NULL;
+  if (bfs->memory == NULL || bfs->front == NULL || bfs->next == NULL
+      || bfs->touched == NULL || (distances && bfs->entries == NULL))
+    {
+      laby_bfs_free (bfs);
+      errno = ENOMEM;
+      return -1;
+    }
+  bfs->front_count = 0;
+  bfs->touched_count = 0;
+  bfs->steps = 0;
+  bfs->first_block = 0;
+  bfs->first_room = 0;
+
+  memset (bfs->memory, 0, size);
+  bfs->blocks = bfs->memory + guard;
+  Laby_Bfs_Block wall = { ~(uint64_t)0, ~(uint64_t)0, ~(uint64_t)0, 0 };
+  for (long i = 0; i < guard; i++)
+    bfs->memory[i] = bfs->blocks[bfs->blocks_count + i] = wall;
+
+  /* 64 rooms of the row are spread over 8 blocks */
+  for (int r = 0; r < lab->rows; r++)
+    for (int c = 0; c < lab->cols; c += 64)
+      {
+        uint64_t right = laby_get_bits (lab, LP_RIGHT, r, c);
+        uint64_t bottom = laby_get_bits (lab, LP_BOTTOM, r, c);
+        for (int j = 0; j < 8 && c + j * 8 < lab->cols; j++)
+          {
+            long w = laby_bfs_block (bfs, r, c + j * 8);
+            Laby_Bfs_Block *b = &bfs->blocks[w];
+            b->right |= (right >> (j * 8) & ROW_FIRST) << (r & 7) * 8;
+            b->bottom |= (bottom >> (j * 8) & ROW_FIRST) << (r & 7) * 8;
+          }
+      }
+
+  /* the rooms after the last column and row are behind borders */
+  for (int r = 0; r < lab->rows; r++)
+    {
+      Laby_Bfs_Block *b = &bfs->blocks[laby_bfs_block (bfs, r, lab->cols - 1)];
+      uint64_t rest = ROW_FIRST << ((lab->cols - 1) & 7);
+      b->right |= (rest & ROW_FIRST) << (r & 7) * 8;
+      b->bottom |= (rest << 1 & ROW_FIRST) << (r & 7) * 8;
+    }
+  for (int r = lab->rows - 1; r < (lab->rows + 7) / 8 * 8; r++)
+    for (long bc = 0; bc < bfs->blocks_cols; bc++)
+      {
+        Laby_Bfs_Block *b = &bfs->blocks[laby_bfs_block (bfs, r, bc * 8)];
+        b->bottom |= (uint64_t)ROW_FIRST << (r & 7) * 8;
+        if (r >= lab->rows)
+          b->right |= (uint64_t)ROW_FIRST << (r & 7) * 8;
+      }
+  return 0;
+}
+
+void
+laby_bfs_free (Laby_Bfs *bfs)
+{
+  free (bfs->memory);
+  free (bfs->front);
+  free (bfs->next);
+  free (bfs->touched);
+  free (bfs->entries);
+  bfs->memory = NULL;
+  bfs->blocks = NULL;
+  bfs->front = NULL;
+  bfs->next = NULL;
+  bfs->touched = NULL;
+  bfs->entries = NULL;
+}
+
+void
+laby_bfs_clear (Laby_Bfs *bfs)
+{
+  for (long i = 0; i < bfs->touched_count; i++)
+    bfs->blocks[bfs->touched[i]].visited = 0;
+  if (bfs->entries)
+    for (long i = 0; i < bfs->touched_count; i++)
+      bfs->entries[bfs->touched[i]].rooms = 0;
+  bfs->touched_count = 0;
+}
+
+void
+laby_bfs_start (Laby_Bfs *bfs, int r, int c)
+{
+  assert (laby_is_inside (bfs, r, c));
+  laby_bfs_clear (bfs);
+
+  long w = laby_bfs_block (bfs, r, c);
+  uint64_t room = (uint64_t)1 << laby_bfs_bit (r, c);
+  bfs->blocks[w].visited = room;
+  bfs->touched[bfs->touched_count++] = w;
+  bfs->first_block = w;
+  bfs->first_room = room;
+  bfs->front[0].block = w;
+  bfs->front[0].rooms = room;
+  bfs->front_count = 1;
+  bfs->steps = 0;
+}
+
+/* Returns the rooms of the next front by moves inside the block */
+static inline uint64_t
+inner_moves (const Laby_Bfs_Block *b, uint64_t f)
+{
+  uint64_t east = f & ~b->right;
+  uint64_t south = f & ~b->bottom;
+  return (east << 1 & ~COL_FIRST) | (f >> 1 & ~COL_LAST & ~b->right)
+         | south << 8 | (f >> 8 & ~b->bottom);
+}
+
+/* The state of the step, which is kept in registers instead of fields of
+ * the search, because fields are reloaded after every store to blocks */
+typedef struct
+{
+  Laby_Bfs_Block *blocks;
+  Laby_Bfs_Entries *entries;
+  /* The end of the list of blocks of the next front */
+  long *next;
+  /* The count of steps to the next front */
+  long steps;
+} Step;
+
+/**
+ * Adds not visited rooms of the block w to the next front, and writes the
+ * block to the end of the list, which grows only for the new block of the
+ * next front. Returns the added rooms.
+ */
+static inline uint64_t
+add_rooms (Step *s, long w, uint64_t rooms)
+{
+  Laby_Bfs_Block *b = &s->blocks[w];
+  rooms &= ~b->visited;
+  *s->next = w;
+  s->next += (b->next == 0) & (rooms != 0);
+  b->next |= rooms;
+  b->visited |= rooms;
+  return rooms;
+}
+
+/* Adds rooms moved from another block, and keeps steps to them */
+static inline void
+enter_rooms (Step *s, long w, uint64_t rooms)
+{
+  rooms = add_rooms (s, w, rooms);
+  if (s->entries == NULL || rooms == 0)
+    return;
+  Laby_Bfs_Entries *e = &s->entries[w];
+  e->rooms |= rooms;
+  for (; rooms; rooms &= rooms - 1)
+    e->steps[side_index (rooms)] = s->steps;
+}
+
+_Bool
+laby_bfs_step (Laby_Bfs *bfs)
+{
+  long blocks_cols = bfs->blocks_cols;
+  Laby_Bfs_Block *blocks = bfs->blocks;
+  Laby_Bfs_Front *front = bfs->front;
+  long front_count = bfs->front_count;
+  Step s = { blocks, bfs->entries, bfs->next, bfs->steps + 1 };
+  for (long i = 0; i < front_count; i++)
+    {
+      long w = front[i].block;
+      uint64_t f = front[i].rooms;
+      const Laby_Bfs_Block *b = &blocks[w];
+
+      add_rooms (&s, w, inner_moves (b, f));
+      /* a few moves leave the block, so branches are predictable. The last
+       * rooms of rows and columns have borders, so the moves through the
+       * sides of blocks never cross the labyrinth, and guard blocks are
+       * never changed */
+      if (f & ~b->right & COL_LAST)
+        enter_rooms (&s, w + 1, (f & ~b->right & COL_LAST) >> 7);
+      if ((f & ~b->bottom) >> 56)
+        enter_rooms (&s, w + blocks_cols, (f & ~b->bottom) >> 56);
+      if (f & COL_FIRST)
+        enter_rooms (&s, w - 1, (f & COL_FIRST) << 7 & ~b[-1].right);
+      if (f & ROW_FIRST)
+        enter_rooms (&s, w - blocks_cols,
+                     (f & ROW_FIRST) << 56 & ~b[-blocks_cols].bottom);
+    }
+  long next_count = s.next - bfs->next;
+  if (next_count == 0)
+    return 0;
+
+  /* the block is visited first, when all its visited rooms are new */
+  long *touched = bfs->touched + bfs->touched_count;
+  for (long i = 0; i < next_count; i++)
+    {
+      long w = bfs->next[i];
+      uint64_t rooms = blocks[w].next;
+      front[i].block = w;
+      front[i].rooms = rooms;
+      blocks[w].next = 0;
+      *touched = w;
+      touched += blocks[w].visited == rooms;
+    }
+  bfs->touched_count = touched - bfs->touched;
+  bfs->front_count = next_count;
+  bfs->steps++;
+  return 1;
+}
+
+long
+laby_bfs_run (Laby_Bfs *bfs, int r, int c, int tr, int tc, long radius)
+{
+  laby_bfs_start (bfs, r, c);
+  while (1)
+    {
+      /* the target is in the front, when it's visited first time */
+      if (tr >= 0 && laby_bfs_is_visited (bfs, tr, tc))
+        return bfs->steps;
+      if (bfs->steps == radius || !laby_bfs_step (bfs))
+        return (tr >= 0) ? -1 : bfs->steps;
+    }
+}
+
+long
+laby_bfs_front_size (const Laby_Bfs *bfs)
+{
+  long count = 0;
+  for (long i = 0; i < bfs->front_count; i++)
+    count += __builtin_popcountll (bfs->front[i].rooms);
+  return count;
+}
+
+void
+laby_bfs_front_room (const Laby_Bfs *bfs, long k, int *r, int *c)
+{
+  long i = 0;
+  uint64_t rooms;
+  for (; k >= __builtin_popcountll (rooms = bfs->front[i].rooms); i++)
+    k -= __builtin_popcountll (rooms);
+  for (; k > 0; k--)
+    rooms &= rooms - 1;
+  long w = bfs->front[i].block;
+  int bit = __builtin_ctzll (rooms);
+  *r = w / bfs->blocks_cols * 8 + bit / 8;
+  *c = w % bfs->blocks_cols * 8 + bit % 8;
+}
+
+long
+laby_bfs_distance (const Laby_Bfs *bfs, int r, int c)
+{
+  assert (bfs->entries);
+  if (!laby_bfs_is_visited (bfs, r, c))
+    return -1;
+  long w = laby_bfs_block (bfs, r, c);
+  uint64_t room = (uint64_t)1 << laby_bfs_bit (r, c);
+  const Laby_Bfs_Entries *e = &bfs->entries[w];
+
+  /* the entries of the block and the first room sorted by steps */
+  uint64_t rooms[29];
+  long steps[29];
+  int count = 0;
+  if (w == bfs->first_block)
+    {
+      rooms[0] = bfs->first_room;
+      steps[0] = 0;
+      count = 1;
+    }
+  for (uint64_t left = e->rooms; left; left &= left - 1)
+    {
+      long step = e->steps[side_index (left)];
+      int i = count++;
+      for (; i > 0 && steps[i - 1] > step; i--)
+        {
+          rooms[i] = rooms[i - 1];
+          steps[i] = steps[i - 1];
+        }
+      rooms[i] = left & -left;
+      steps[i] = step;
+    }
+
+  /* the search inside the block, which waits for the next entry when its
+   * front is empty */
+  const Laby_Bfs_Block *b = &bfs->blocks[w];
+  uint64_t visited = 0, front = 0;
+  long step = 0;
+  for (int i = 0;; step++)
+    {
+      if (front == 0)
+        {
+          assert (i < count);
+          step = steps[i];
+        }
+      for (; i < count && steps[i] == step; i++)
+        front |= rooms[i] & ~visited;
+      if (front & room)
+        return step;
+      visited |= front;
+      front = inner_moves (b, front) & ~visited;
+    }
+}
@@ -0,0 +1,201 @@
+#ifndef __LABY_BFS__
+#define __LABY_BFS__
+
+#include "laby.h"
+#include <assert.h>
+
+/* The rooms of the first column of the block of the search */
+#define LABY_BFS_COL_FIRST 0x0101010101010101
+
+/* The index of the block with the room r:c */
+#define laby_bfs_block(bfs, r, c)                                             \
+  (((long)(r) >> 3) * (bfs)->blocks_cols + ((c) >> 3))
+
+/* The bit of the room r:c in its block */
+#define laby_bfs_bit(r, c) (((r)&7) * 8 + ((c)&7))
+
+/**
+ * The state of 8x8 rooms in the breadth-first search. The bit
+ * (r % 8) * 8 + c % 8 of every word is about the room r:c. The block takes a
+ * half of the cache line, so moves in every direction touch one line.
+ */
+typedef struct
+{
+  /* The right and bottom borders of the rooms. Passages out of the
+   * labyrinth are borders too. */
+  uint64_t right;
+  uint64_t bottom;
+  /* The rooms reached by the search */
+  uint64_t visited;
+  /* The rooms of the next front */
+  uint64_t next;
+} Laby_Bfs_Block;
+
+/**
+ * The rooms of the block visited first by moves from other blocks, and the
+ * counts of steps to them. A step to every other room follows from these by
+ * moves inside the block, so the count is kept for 28 rooms of sides of the
+ * block instead of every room, in the order of their bits.
+ */
+typedef struct
+{
+  uint64_t rooms;
+  uint32_t steps[28];
+} Laby_Bfs_Entries;
+
+/* The not empty block of the front and its rooms of the front */
+typedef struct
+{
+  long block;
+  uint64_t rooms;
+} Laby_Bfs_Front;
+
+/**
+ * The breadth-first search over the copy of borders of the labyrinth. The
+ * front is moved by 64 rooms at once. One search can be run after another
+ * on the same labyrinth without new allocations, and only blocks reached by
+ * the previous search are cleaned, so short searches take short time.
+ * The copy takes 4 bits per room, and distances take 15 bits per room more.
+ */
+typedef struct
+{
+  int rows;
+  int cols;
+  /* The count of blocks by horizontal */
+  long blocks_cols;
+  long blocks_count;
+  Laby_Bfs_Block *blocks;
+  /* The allocated blocks with the row of guards before and after the
+   * blocks of the labyrinth. Guards are visited rooms with all borders. */
+  Laby_Bfs_Block *memory;
+
+  /* The current front, which is never empty */
+  Laby_Bfs_Front *front;
+  long front_count;
+  /* The count of steps from the first room to rooms of the front */
+  long steps;
+
+  /* The blocks of the next front, while the step is made */
+  long *next;
+
+  /* The blocks with visited rooms, which should be cleaned before the next
+   * search */
+  long *touched;
+  long touched_count;
+
+  /* The first room of the search and its block */
+  long first_block;
+  uint64_t first_room;
+  /* The entries of the front to every block, or NULL when distances are
+   * not needed */
+  Laby_Bfs_Entries *entries;
+} Laby_Bfs;
+
+/* Returns the left borders of rooms of the block w */
+static inline uint64_t
+laby_bfs_left_borders (const Laby_Bfs *bfs, long w)
+{
+  /* the left borders of the first column are taken from the previous
+   * block, which is the last one of the previous row or the guard, and has
+   * borders in the last column */
+  const Laby_Bfs_Block *b = &bfs->blocks[w];
+  return (b->right << 1 & ~LABY_BFS_COL_FIRST)
+         | (b[-1].right >> 7 & LABY_BFS_COL_FIRST);
+}
+
+/* Returns the upper borders of rooms of the block w */
+static inline uint64_t
+laby_bfs_upper_borders (const Laby_Bfs *bfs, long w)
+{
+  const Laby_Bfs_Block *b = &bfs->blocks[w];
+  return b->bottom << 8 | b[-bfs->blocks_cols].bottom >> 56;
+}
+
+/**
+ * Copies borders of the labyrinth for the search, and allocates memory for
+ * the distances to rooms, if `distances` is true. The LL_RING labyrinth is
+ * not supported.
+ * Returns 0 on success, or -1 and sets errno, when the memory can't be
+ * allocated. Nothing has to be freed after the error.
+ */
+int laby_bfs_init (Laby_Bfs *bfs, const Laby *lab, _Bool distances);
+
+void laby_bfs_free (Laby_Bfs *bfs);
+
+/* Forgets rooms visited by the last search */
+void laby_bfs_clear (Laby_Bfs *bfs);
+
+/**
+ * Marks the room r:c as visited for searches with their own order of rooms.
+ * Returns 0 when the room was visited already. The front is not changed.
+ */
+static inline _Bool
+laby_bfs_visit (Laby_Bfs *bfs, int r, int c)
+{
+  assert (laby_is_inside (bfs, r, c));
+  long w = laby_bfs_block (bfs, r, c);
+  uint64_t room = (uint64_t)1 << laby_bfs_bit (r, c);
+  Laby_Bfs_Block *b = &bfs->blocks[w];
+  if (b->visited & room)
+    return 0;
+  if (b->visited == 0)
+    bfs->touched[bfs->touched_count++] = w;
+  b->visited |= room;
+  return 1;
+}
+
+/* Starts the new search from the room r:c. */
+void laby_bfs_start (Laby_Bfs *bfs, int r, int c);
+
+/**
+ * Moves the front on one step through all passages of its rooms. Returns 0
+ * and keeps the front, when there are no more rooms to visit.
+ */
+_Bool laby_bfs_step (Laby_Bfs *bfs);
+
+/**
+ * Searches from the room r:c until the room tr:tc is in the front, or all
+ * rooms in `radius` steps are visited. A negative tr or radius means no
+ * target or no limit. Returns the count of steps to the target, or -1 when
+ * it's not reached. Without the target returns the count of steps to the
+ * farthest visited rooms, which are left in the front.
+ */
+long laby_bfs_run (Laby_Bfs *bfs, int r, int c, int tr, int tc, long radius);
+
+/* Returns the count of rooms in the front */
+long laby_bfs_front_size (const Laby_Bfs *bfs);
+
+/* Takes the k-th room of the front (0 <= k < laby_bfs_front_size) */
+void laby_bfs_front_room (const Laby_Bfs *bfs, long k, int *r, int *c);
+
+/* Returns the borders of the room as laby_get_borders does */
+static inline unsigned char
+laby_bfs_borders (const Laby_Bfs *bfs, int r, int c)
+{
+  assert (laby_is_inside (bfs, r, c));
+  long w = laby_bfs_block (bfs, r, c);
+  int bit = laby_bfs_bit (r, c);
+  return (bfs->blocks[w].bottom >> bit & 1)
+         | (bfs->blocks[w].right >> bit & 1) << 1
+         | (laby_bfs_upper_borders (bfs, w) >> bit & 1) << 2
+         | (laby_bfs_left_borders (bfs, w) >> bit & 1) << 3;
+}
+
+/* Returns 1 when the room r:c was visited by the last search */
+static inline _Bool
+laby_bfs_is_visited (const Laby_Bfs *bfs, int r, int c)
+{
+  assert (laby_is_inside (bfs, r, c));
+  long w = laby_bfs_block (bfs, r, c);
+  return (bfs->blocks[w].visited >> laby_bfs_bit (r, c)) & 1;
+}
+
+/**
+ * Returns the count of steps from the first room of the last search to the
+ * room r:c, or -1 when the room was not visited. The search must be
+ * initialized with distances. The count is found by moves inside the block
+ * of the room from the entries of the front, so it takes up to 64 steps.
+ */
+long laby_bfs_distance (const Laby_Bfs *bfs, int r, int c);
+
+#endif /* __LABY_BFS__ */
@@ -0,0 +1,310 @@
+/**
+ * The cache of generated labyrinths on the disk, which is used to not
+ * generate giant labyrinths again, when the game is run with the same seed.
+ */
+#include "laby_cache.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define LABY_CACHE_MAGIC "LABC"
+#define LABY_CACHE_VERSION 1
+
+/* The suffix of files of the cache, other files in the directory are kept */
+#define LABY_CACHE_SUFFIX ".laby"
+
+/* The buffer of the stream of packed rows written by laby_cache_store */
+#define LABY_CACHE_BUFFER_SIZE (1 << 20)
+
+/* The checksum of no words */
+#define CHECKSUM_INIT 0xcbf29ce484222325
+
+/**
+ * The header of the file in the cache. The borders packed by
+ * laby_pack_borders follow the header. All numbers are in the byte order of
+ * the host.
+ */
+typedef struct
+{
+  char magic[4];
+  uint32_t version;
+  uint32_t generators_version;
+  int32_t rows;
+  int32_t cols;
+  uint32_t reserved;
+  uint64_t seed;
+  uint64_t next_seed;
+  /* The checksum of the packed borders */
+  uint64_t checksum;
+} Laby_Cache_Header;
+
+/* The file of the cache found by the eviction */
+typedef struct
+{
+  char name[NAME_MAX + 1];
+  off_t size;
+  struct timespec used;
+} Cache_File;
+
+/**
+ * Continues the checksum `sum` by the words, so the words can be summed in
+ * parts. Multiplication by the odd number is reversible, so a change of any
+ * single word always changes the sum.
+ */
+static uint64_t
+checksum (uint64_t sum, const uint64_t *words, size_t count)
+{
+  for (size_t i = 0; i < count; i++)
+    sum = (sum ^ words[i]) * 0x100000001b3;
+  return sum;
+}
+
+/* Creates the directory, if it's absent */
+static int
+make_dir (const char *path)
+{
+  return (mkdir (path, 0755) == 0 || errno == EEXIST) ? 0 : -1;
+}
+
+/* The cache in the directory without the write access is only read */
+static int
+check_access (Laby_Cache *cache)
+{
+  if (access (cache->dir, R_OK | X_OK) != 0)
+    return -1;
+  cache->read_only = access (cache->dir, W_OK) != 0;
+  return 0;
+}
+
+int
+laby_cache_open (Laby_Cache *cache, const char *dir, long max_size)
+{
+  cache->max_size = max_size;
+  cache->read_only = 0;
+  if (dir)
+    {
+      if (snprintf (cache->dir, PATH_MAX, "%s", dir) >= PATH_MAX)
+        {
+          errno = ENAMETOOLONG;
+          return -1;
+        }
+      return (make_dir (cache->dir) == 0) ? check_access (cache) : -1;
+    }
+
+  char base[PATH_MAX];
+  const char *xdg = getenv ("XDG_CACHE_HOME");
+  const char *home = getenv ("HOME");
+  /* relative paths in XDG variables must be ignored */
+  if (xdg && xdg[0] == '/')
+    snprintf (base, PATH_MAX, "%s", xdg);
+  else if (home && home[0])
+    snprintf (base, PATH_MAX, "%s/.cache", home);
+  else
+    {
+      errno = ENOENT;
+      return -1;
+    }
+  if (snprintf (cache->dir, PATH_MAX, "%s/labyrinth", base) >= PATH_MAX)
+    {
+      errno = ENAMETOOLONG;
+      return -1;
+    }
+  /* the existing directory is used, even if its parent is read-only */
+  if (access (cache->dir, F_OK) != 0
+      && (make_dir (base) != 0 || make_dir (cache->dir) != 0))
+    return -1;
+  return check_access (cache);
+}
+
+/* Builds the path to the file with the labyrinth */
+static int
+file_path (const Laby_Cache *cache, char *path, const char *generator,
+           lcg seed, int rows, int cols)
+{
+  int n = snprintf (path, PATH_MAX, "%s/%s-v%d-%llu-%dx%d%s", cache->dir,
+                    generator, LABY_GENERATORS_VERSION,
+                    (unsigned long long)seed, rows, cols, LABY_CACHE_SUFFIX);
+  return (n < PATH_MAX) ? 0 : -1;
+}
+
+int
+laby_cache_load (const Laby_Cache *cache, const char *generator,
+                 lcg *seed, int rows, int cols, Laby *lab)
+{
+  char path[PATH_MAX];
+  if (file_path (cache, path, generator, *seed, rows, cols) != 0)
+    return -1;
+  int fd = open (path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  struct stat st;
+  size_t words_count = laby_packed_words (rows, cols);
+  size_t size = sizeof (Laby_Cache_Header) + sizeof (uint64_t) * words_count;
+  if (fstat (fd, &st) != 0 || (uint64_t)st.st_size != size)
+    {
+      close (fd);
+      unlink (path);
+      return -1;
+    }
+  void *map = mmap (NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close (fd);
+  if (map == MAP_FAILED)
+    return -1;
+  /* the whole file is read by the checksum anyway */
+  madvise (map, size, MADV_SEQUENTIAL);
+
+  const Laby_Cache_Header *header = map;
+  const uint64_t *words = (const uint64_t *)(header + 1);
+  if (memcmp (header->magic, LABY_CACHE_MAGIC, sizeof (header->magic)) != 0
+      || header->version != LABY_CACHE_VERSION
+      || header->generators_version != LABY_GENERATORS_VERSION
+      || header->rows != rows || header->cols != cols
+      || header->seed != *seed
+      || header->checksum != checksum (CHECKSUM_INIT, words, words_count))
+    {
+      munmap (map, size);
+      unlink (path);
+      return -1;
+    }
+
+  laby_unpack_borders (lab, rows, cols, words);
+  *seed = header->next_seed;
+  munmap (map, size);
+  /* the time of modification is the time of the last use */
+  utimensat (AT_FDCWD, path, NULL, 0);
+  return 0;
+}
+
+static int
+compare_usage (const void *a, const void *b)
+{
+  const struct timespec *x = &((const Cache_File *)a)->used;
+  const struct timespec *y = &((const Cache_File *)b)->used;
+  if (x->tv_sec != y->tv_sec)
+    return (x->tv_sec < y->tv_sec) ? -1 : 1;
+  return (x->tv_nsec > y->tv_nsec) - (x->tv_nsec < y->tv_nsec);
+}
+
+/* Removes the least recently used files until the cache fits to the size */
+static void
+evict (const Laby_Cache *cache)
+{
+  DIR *dir = opendir (cache->dir);
+  if (dir == NULL)
+    return;
+
+  int count = 0, capacity = 16;
+  Cache_File *files = malloc (sizeof (Cache_File) * capacity);
+  long total = 0;
+  size_t suffix = strlen (LABY_CACHE_SUFFIX);
+  char path[PATH_MAX];
+  struct dirent *e;
+  while ((e = readdir (dir)) != NULL)
+    {
+      size_t len = strlen (e->d_name);
+      struct stat st;
+      if (len <= suffix
+          || strcmp (e->d_name + len - suffix, LABY_CACHE_SUFFIX) != 0
+          || snprintf (path, PATH_MAX, "%s/%s", cache->dir, e->d_name)
+                 >= PATH_MAX
+          || stat (path, &st) != 0 || !S_ISREG (st.st_mode))
+        continue;
+      if (count == capacity)
+        {
+          capacity *= 2;
+          files = realloc (files, sizeof (Cache_File) * capacity);
+        }
+      memcpy (files[count].name, e->d_name, len + 1);
+      files[count].size = st.st_size;
+      files[count].used = st.st_mtim;
+      total += st.st_size;
+      count++;
+    }
+  closedir (dir);
+
+  qsort (files, count, sizeof (Cache_File), compare_usage);
+  for (int i = 0; i < count && total > cache->max_size; i++)
+    {
+      if (snprintf (path, PATH_MAX, "%s/%s", cache->dir, files[i].name)
+              < PATH_MAX
+          && unlink (path) == 0)
+        total -= files[i].size;
+    }
+  free (files);
+}
+
+int
+laby_cache_store (const Laby_Cache *cache, const char *generator,
+                  lcg seed, lcg next_seed, const Laby *lab)
+{
+  if (cache->read_only)
+    {
+      errno = EROFS;
+      return -1;
+    }
+  if (lab->layout == LL_RING)
+    {
+      errno = EINVAL;
+      return -1;
+    }
+  size_t words_count = laby_packed_words (lab->rows, lab->cols);
+  size_t size = sizeof (Laby_Cache_Header) + sizeof (uint64_t) * words_count;
+  if (size > (size_t)cache->max_size)
+    {
+      errno = EFBIG;
+      return -1;
+    }
+
+  char path[PATH_MAX], tmp[PATH_MAX];
+  if (file_path (cache, path, generator, seed, lab->rows, lab->cols) != 0
+      || snprintf (tmp, PATH_MAX, "%s.%d.tmp", path, (int)getpid ())
+             >= PATH_MAX)
+    {
+      errno = ENAMETOOLONG;
+      return -1;
+    }
+
+  /* rows are packed right before they are written, and the checksum is
+   * written to the header after all rows */
+  size_t row_count = laby_packed_words (1, lab->cols);
+  uint64_t *row = malloc (sizeof (uint64_t) * row_count);
+  Laby_Cache_Header header = { LABY_CACHE_MAGIC,
+                               LABY_CACHE_VERSION,
+                               LABY_GENERATORS_VERSION,
+                               lab->rows,
+                               lab->cols,
+                               0,
+                               seed,
+                               next_seed,
+                               CHECKSUM_INIT };
+
+  FILE *f = (row != NULL) ? fopen (tmp, "wb") : NULL;
+  int ok = f != NULL;
+  if (ok)
+    setvbuf (f, NULL, _IOFBF, LABY_CACHE_BUFFER_SIZE);
+  ok = ok && fwrite (&header, sizeof (header), 1, f) == 1;
+  for (int r = 0; r < lab->rows && ok; r++)
+    {
+      laby_pack_row (lab, r, row);
+      header.checksum = checksum (header.checksum, row, row_count);
+      ok = fwrite (row, sizeof (uint64_t), row_count, f) == row_count;
+    }
+  ok = ok && fseek (f, 0, SEEK_SET) == 0
+       && fwrite (&header, sizeof (header), 1, f) == 1;
+  ok = (f == NULL || fclose (f) == 0) && ok;
+  free (row);
+  if (!ok || rename (tmp, path) != 0)
+    {
+      unlink (tmp);
+      return -1;
+    }
+  evict (cache);
+  return 0;
+}
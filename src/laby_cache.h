@@ -0,0 +1,71 @@
+#ifndef __LABY_CACHE__
+#define __LABY_CACHE__
+
+#include "laby.h"
+#include "lcg.h"
+#include <limits.h>
+
+/**
+ * The version of all generators. It's a part of the key of cached
+ * labyrinths, so it must be increased when any generator begins to give
+ * other labyrinths for the same seed.
+ */
+#define LABY_GENERATORS_VERSION 3
+
+/* The max total size of the cached labyrinths by default */
+#define LABY_CACHE_MAX_SIZE (512L << 20)
+
+/* Smaller labyrinths are generated faster than they are read from the disk */
+#define LABY_CACHE_MIN_ROOMS (1L << 20)
+
+/**
+ * The cache of generated labyrinths on the disk. Every labyrinth is kept in
+ * its own file named by the generator, its version, the seed and the size.
+ * The file has only borders packed by laby_pack_borders (2 bits per room)
+ * and the checksum of them.
+ */
+typedef struct
+{
+  /* The directory with files of the cache */
+  char dir[PATH_MAX];
+  /* The max total size of files in bytes. The least recently used files
+   * are removed, when the cache becomes bigger. */
+  long max_size;
+  /* 1 when labyrinths are only loaded, because the directory can't be
+   * written */
+  _Bool read_only;
+} Laby_Cache;
+
+/**
+ * Opens the cache in the directory `dir`, or in $XDG_CACHE_HOME/labyrinth
+ * (~/.cache/labyrinth, when the variable is not set), if `dir` is NULL.
+ * The directory is created, if it's absent. The directory without the write
+ * access is opened read-only.
+ * Returns 0 on success, or -1 and sets errno on error.
+ */
+int laby_cache_open (Laby_Cache *cache, const char *dir, long max_size);
+
+/**
+ * Loads the labyrinth of rows x cols rooms, which the generator creates from
+ * the seed. The file is read by one mapping, and the seed is set to the
+ * state after the generation, as the generator would do. The loaded file
+ * becomes the most recently used one.
+ * Returns 0 on success, or -1 when the labyrinth is not in the cache. The
+ * file with the wrong checksum is removed.
+ */
+int laby_cache_load (const Laby_Cache *cache, const char *generator,
+                     lcg *seed, int rows, int cols, Laby *lab);
+
+/**
+ * Stores the labyrinth created by the generator from `seed`, where
+ * `next_seed` is the seed after the generation. Rows are packed and written
+ * one by one to the temporary file, which is renamed, so other processes
+ * never read it partially. The read-only cache fails with EROFS.
+ * Then the least recently used files are removed to keep the size of the
+ * cache. The LL_RING labyrinth can't be stored.
+ * Returns 0 on success, or -1 and sets errno on error.
+ */
+int laby_cache_store (const Laby_Cache *cache, const char *generator,
+                      lcg seed, lcg next_seed, const Laby *lab);
+
+#endif /* __LABY_CACHE__ */
@@ -0,0 +1,312 @@
+/**
+ * Different algorithms to generate labyrinths. Every algorithm starts from
+ * the labyrinth with all borders and removes some of them, so the result is
+ * a perfect labyrinth: every room is reachable by the single path.
+ */
+#include "laby_gen.h"
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Directions from the room to its neighbors */
+enum direction
+{
+  D_UP,
+  D_DOWN,
+  D_LEFT,
+  D_RIGHT
+};
+
+/* The indexes of rooms and walls are kept in 32 bits to halve the memory */
+#define MAX_INDEX UINT32_MAX
+
+static int
+generate_eller (Laby *lab, int height, int width, lcg *seed)
+{
+  laby_generate (lab, height, width, seed);
+  return 0;
+}
+
+static int
+generate_eller_v2 (Laby *lab, int height, int width, lcg *seed)
+{
+  laby_init_empty (lab, height, width);
+  laby_generate_eller_version (lab, seed, LEV_2);
+  return 0;
+}
+
+const Laby_Generator laby_generators[] = {
+  { "eller", generate_eller },
+  { "eller2", generate_eller_v2 },
+  { "kruskal", laby_generate_kruskal },
+  { "wilson", laby_generate_wilson },
+  { "backtracker", laby_generate_backtracker },
+};
+
+const int laby_generators_count
+    = sizeof (laby_generators) / sizeof (laby_generators[0]);
+
+const Laby_Generator *
+laby_find_generator (const char *name)
+{
+  for (int i = 0; i < laby_generators_count; i++)
+    if (strcmp (laby_generators[i].name, name) == 0)
+      return &laby_generators[i];
+  return NULL;
+}
+
+/**
+ * Returns the uniform random number in [0, n). The numbers of lcg_rand in
+ * [1, LCG_MODULUS - 1] above the last whole multiple of n are dropped,
+ * because the modulus would give small numbers more often. Two numbers are
+ * combined for n above the range of lcg_rand.
+ */
+static inline long
+rand_below (lcg *seed, long n)
+{
+  _Bool wide = n > LCG_MODULUS - 1;
+  uint64_t range = (uint64_t)(LCG_MODULUS - 1) * (wide ? LCG_MODULUS - 1 : 1);
+  uint64_t limit = range / n * n;
+  uint64_t x;
+  do
+    {
+      x = lcg_rand (seed) - 1;
+      if (wide)
+        x = x * (LCG_MODULUS - 1) + lcg_rand (seed) - 1;
+    }
+  while (x >= limit);
+  return x % n;
+}
+
+/* Creates the labyrinth with borders around every room */
+static void
+init_closed (Laby *lab, int height, int width)
+{
+  laby_init_empty (lab, height, width);
+  laby_fill_rect (lab, LP_RIGHT, 0, 0, height, width, 1);
+  laby_fill_rect (lab, LP_BOTTOM, 0, 0, height, width, 1);
+}
+
+/* Removes the border between the room i and its neighbor in the direction */
+static void
+open_passage (Laby *lab, long i, enum direction d)
+{
+  int r = i / lab->cols;
+  int c = i % lab->cols;
+  static const enum border borders[]
+      = { UPPER_BORDER, BOTTOM_BORDER, LEFT_BORDER, RIGHT_BORDER };
+  laby_rm_border (lab, r, c, borders[d]);
+}
+
+/* Returns the index of the neighbor of the room i in the direction */
+static inline long
+neighbor (const Laby *lab, long i, enum direction d)
+{
+  switch (d)
+    {
+    case D_UP:
+      return i - lab->cols;
+    case D_DOWN:
+      return i + lab->cols;
+    case D_LEFT:
+      return i - 1;
+    default:
+      return i + 1;
+    }
+}
+
+/* Returns 1 if the room i has a neighbor in the direction */
+static inline _Bool
+has_neighbor (const Laby *lab, long i, enum direction d)
+{
+  switch (d)
+    {
+    case D_UP:
+      return i >= lab->cols;
+    case D_DOWN:
+      return i < (long)(lab->rows - 1) * lab->cols;
+    case D_LEFT:
+      return i % lab->cols > 0;
+    default:
+      return i % lab->cols < lab->cols - 1;
+    }
+}
+
+/* Returns the root of the set with path halving */
+static inline uint32_t
+find_root (uint32_t *parent, uint32_t i)
+{
+  while (parent[i] != i)
+    i = parent[i] = parent[parent[i]];
+  return i;
+}
+
+int
+laby_generate_kruskal (Laby *lab, int height, int width, lcg *seed)
+{
+  long rooms = (long)height * width;
+  /* right borders of all rooms except the last column, then bottom borders
+   * of all rooms except the last row */
+  long right = (long)height * (width - 1);
+  long count = right + (long)(height - 1) * width;
+  if (rooms - 1 > MAX_INDEX || count - 1 > MAX_INDEX)
+    {
+      errno = EOVERFLOW;
+      return -1;
+    }
+  uint32_t *walls = malloc (sizeof (uint32_t) * count);
+  uint32_t *parent = malloc (sizeof (uint32_t) * rooms);
+  if (walls == NULL || parent == NULL)
+    {
+      free (walls);
+      free (parent);
+      errno = ENOMEM;
+      return -1;
+    }
+  init_closed (lab, height, width);
+  for (long i = 0; i < count; i++)
+    walls[i] = i;
+  for (long i = 0; i < rooms; i++)
+    parent[i] = i;
+
+  /* Fisher-Yates shuffle of walls */
+  for (long i = count - 1; i > 0; i--)
+    {
+      long j = rand_below (seed, i + 1);
+      uint32_t tmp = walls[i];
+      walls[i] = walls[j];
+      walls[j] = tmp;
+    }
+
+  for (long i = 0, joined = 1; i < count && joined < rooms; i++)
+    {
+      long w = walls[i];
+      long a = (w < right) ? w / (width - 1) * width + w % (width - 1)
+                           : w - right;
+      enum direction d = (w < right) ? D_RIGHT : D_DOWN;
+      uint32_t ra = find_root (parent, a);
+      uint32_t rb = find_root (parent, neighbor (lab, a, d));
+      if (ra == rb)
+        continue;
+      parent[rb] = ra;
+      open_passage (lab, a, d);
+      joined++;
+    }
+
+  free (walls);
+  free (parent);
+  return 0;
+}
+
+/* The room of Wilson's algorithm is in the labyrinth already */
+#define IN_TREE 0x80
+
+int
+laby_generate_wilson (Laby *lab, int height, int width, lcg *seed)
+{
+  long rooms = (long)height * width;
+  /* the last direction of the walk from every room, or IN_TREE */
+  unsigned char *dirs = calloc (rooms, sizeof (unsigned char));
+  if (dirs == NULL)
+    {
+      errno = ENOMEM;
+      return -1;
+    }
+  init_closed (lab, height, width);
+  dirs[rand_below (seed, rooms)] = IN_TREE;
+
+  for (long start = 0; start < rooms; start++)
+    {
+      /* random walk until the labyrinth. Only the last direction from every
+       * room is kept, so loops are erased by the next visit */
+      long i = start;
+      while (!(dirs[i] & IN_TREE))
+        {
+          enum direction d;
+          do
+            d = rand_below (seed, 4);
+          while (!has_neighbor (lab, i, d));
+          dirs[i] = d;
+          i = neighbor (lab, i, d);
+        }
+      /* add the loop-erased path to the labyrinth */
+      for (i = start; !(dirs[i] & IN_TREE);)
+        {
+          enum direction d = dirs[i];
+          open_passage (lab, i, d);
+          dirs[i] = IN_TREE;
+          i = neighbor (lab, i, d);
+        }
+    }
+  free (dirs);
+  return 0;
+}
+
+int
+laby_generate_backtracker (Laby *lab, int height, int width, lcg *seed)
+{
+  long rooms = (long)height * width;
+  if (rooms - 1 > MAX_INDEX)
+    {
+      errno = EOVERFLOW;
+      return -1;
+    }
+  uint64_t *visited = calloc ((rooms + 63) / 64, sizeof (uint64_t));
+  long capacity = 1024;
+  long top = 0;
+  uint32_t *stack = malloc (sizeof (uint32_t) * capacity);
+  if (visited == NULL || stack == NULL)
+    {
+      free (visited);
+      free (stack);
+      errno = ENOMEM;
+      return -1;
+    }
+  init_closed (lab, height, width);
+
+  long start = rand_below (seed, rooms);
+  visited[start / 64] |= (uint64_t)1 << (start % 64);
+  stack[top++] = start;
+  while (top > 0)
+    {
+      long i = stack[top - 1];
+      /* not visited neighbors of the newest room */
+      enum direction free_dirs[4];
+      int n = 0;
+      for (enum direction d = D_UP; d <= D_RIGHT; d++)
+        if (has_neighbor (lab, i, d))
+          {
+            long j = neighbor (lab, i, d);
+            if (!(visited[j / 64] & (uint64_t)1 << (j % 64)))
+              free_dirs[n++] = d;
+          }
+      if (n == 0)
+        {
+          top--;
+          continue;
+        }
+      enum direction d = free_dirs[rand_below (seed, n)];
+      long j = neighbor (lab, i, d);
+      open_passage (lab, i, d);
+      visited[j / 64] |= (uint64_t)1 << (j % 64);
+      if (top == capacity)
+        {
+          uint32_t *grown
+              = realloc (stack, sizeof (uint32_t) * 2 * capacity);
+          if (grown == NULL)
+            {
+              free (visited);
+              free (stack);
+              laby_free (lab);
+              errno = ENOMEM;
+              return -1;
+            }
+          stack = grown;
+          capacity *= 2;
+        }
+      stack[top++] = j;
+    }
+  free (visited);
+  free (stack);
+  return 0;
+}
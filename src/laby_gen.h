@@ -0,0 +1,53 @@
+#ifndef __LABY_GEN__
+#define __LABY_GEN__
+
+#include "laby.h"
+#include "lcg.h"
+
+/**
+ * The algorithm to generate labyrinths. Every generator creates a new
+ * labyrinth with height x width rooms, and the result depends only on the
+ * seed. The generator returns 0 on success, or -1 and sets errno, when its
+ * memory can't be allocated or the labyrinth is too big for it. The
+ * labyrinth is not created after the error.
+ */
+typedef struct
+{
+  /* The name of the algorithm, which is used in the -g option */
+  const char *name;
+
+  int (*generate) (Laby *lab, int height, int width, lcg *seed);
+} Laby_Generator;
+
+/* All available generators. The first one is the default. */
+extern const Laby_Generator laby_generators[];
+
+extern const int laby_generators_count;
+
+/* Returns the generator with the name, or NULL. */
+const Laby_Generator *laby_find_generator (const char *name);
+
+/**
+ * Randomized Kruskal's algorithm: all walls are removed in random order, if
+ * they divide rooms, which are not connected yet (union-find of rooms).
+ * Rooms and walls are indexed by 32 bits, so it makes labyrinths up to 2^31
+ * rooms.
+ */
+int laby_generate_kruskal (Laby *lab, int height, int width, lcg *seed);
+
+/**
+ * Wilson's algorithm: loop-erased random walks from every room not in the
+ * labyrinth yet, until the walk hits the labyrinth. Gives a uniform spanning
+ * tree, but the first walks are long.
+ */
+int laby_generate_wilson (Laby *lab, int height, int width, lcg *seed);
+
+/**
+ * Growing tree, which always continues from the newest room (recursive
+ * backtracker). The stack of rooms is kept in the heap, so giant labyrinths
+ * don't overflow the call stack. Rooms are indexed by 32 bits, so it makes
+ * labyrinths up to 2^32 rooms.
+ */
+int laby_generate_backtracker (Laby *lab, int height, int width, lcg *seed);
+
+#endif /* __LABY_GEN__ */
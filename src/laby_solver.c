@@ -0,0 +1,165 @@
+/**
+ * The A* search of the shortest path between two rooms of the labyrinth.
+ */
+#include "laby_solver.h"
+#include <errno.h>
+#include <stdlib.h>
+
+/* The initial count of rooms in every stack of the queue */
+#define OPEN_SIZE 1024
+
+/* The moves from the room through every of its borders. The opposite move
+ * of the move i is i ^ 1. */
+static const struct
+{
+  enum border border;
+  int dr;
+  int dc;
+} moves[] = { { UPPER_BORDER, -1, 0 },
+              { BOTTOM_BORDER, 1, 0 },
+              { LEFT_BORDER, 0, -1 },
+              { RIGHT_BORDER, 0, 1 } };
+
+int
+laby_solver_init (Laby_Solver *solver, const Laby *lab)
+{
+  solver->next = NULL;
+  solver->open[0] = solver->open[1] = NULL;
+  /* there is no last search */
+  solver->row = solver->col = -1;
+  if (laby_bfs_init (&solver->bfs, lab, 0) != 0)
+    return -1;
+  solver->next = malloc (sizeof (uint64_t) * 2 * solver->bfs.blocks_count);
+  for (int i = 0; i < 2; i++)
+    {
+      solver->open[i] = malloc (sizeof (Laby_Solver_Node) * OPEN_SIZE);
+      solver->open_count[i] = 0;
+      solver->open_size[i] = OPEN_SIZE;
+    }
+  if (solver->next == NULL || solver->open[0] == NULL
+      || solver->open[1] == NULL)
+    {
+      laby_solver_free (solver);
+      errno = ENOMEM;
+      return -1;
+    }
+  return 0;
+}
+
+void
+laby_solver_free (Laby_Solver *solver)
+{
+  laby_bfs_free (&solver->bfs);
+  free (solver->next);
+  free (solver->open[0]);
+  free (solver->open[1]);
+  solver->next = NULL;
+  solver->open[0] = solver->open[1] = NULL;
+  /* there is no last search */
+  solver->row = solver->col = -1;
+}
+
+static inline int
+push (Laby_Solver *solver, int i, int r, int c, int next)
+{
+  if (solver->open_count[i] == solver->open_size[i])
+    {
+      Laby_Solver_Node *open
+          = realloc (solver->open[i],
+                     sizeof (Laby_Solver_Node) * 2 * solver->open_size[i]);
+      if (open == NULL)
+        {
+          errno = ENOMEM;
+          return -1;
+        }
+      solver->open[i] = open;
+      solver->open_size[i] *= 2;
+    }
+  Laby_Solver_Node *node = &solver->open[i][solver->open_count[i]++];
+  node->row = r;
+  node->col = c;
+  node->next = next;
+  return 0;
+}
+
+long
+laby_solve (Laby_Solver *solver, int r, int c, int tr, int tc)
+{
+  Laby_Bfs *bfs = &solver->bfs;
+  /* closed rooms keep the shortest paths to the target, because the
+   * heuristic is consistent, so they don't depend on the start */
+  if (tr == solver->row && tc == solver->col
+      && laby_bfs_is_visited (bfs, r, c))
+    {
+      long length = 0;
+      while (laby_solver_next_room (solver, &r, &c))
+        length++;
+      return length;
+    }
+  laby_bfs_clear (bfs);
+  solver->open_count[0] = solver->open_count[1] = 0;
+  solver->row = tr;
+  solver->col = tc;
+
+  /* the estimation of paths through rooms of the current stack */
+  long estimation = labs ((long)tr - r) + labs ((long)tc - c);
+  int current = 0;
+  push (solver, current, tr, tc, 0);
+  while (1)
+    {
+      if (solver->open_count[current] == 0)
+        {
+          if (solver->open_count[!current] == 0)
+            return -1;
+          current = !current;
+          estimation += 2;
+        }
+      /* the last pushed room is taken first, so the search goes deep
+       * through rooms with the same estimation */
+      Laby_Solver_Node node
+          = solver->open[current][--solver->open_count[current]];
+      /* the room could be pushed a few times, but only the first one has
+       * the shortest path, when the labyrinth has cycles */
+      if (!laby_bfs_visit (bfs, node.row, node.col))
+        continue;
+      uint64_t *next = &solver->next[2 * laby_bfs_block (bfs, node.row,
+                                                        node.col)];
+      int bit = laby_bfs_bit (node.row, node.col);
+      next[0] = (next[0] & ~((uint64_t)1 << bit))
+                | (uint64_t)(node.next & 1) << bit;
+      next[1] = (next[1] & ~((uint64_t)1 << bit))
+                | (uint64_t)(node.next >> 1) << bit;
+      /* the estimation is the length of the path in the start */
+      if (node.row == r && node.col == c)
+        return estimation;
+
+      unsigned char borders = laby_bfs_borders (bfs, node.row, node.col);
+      int distance = abs (node.row - r) + abs (node.col - c);
+      for (int i = 0; i < 4; i++)
+        {
+          int nr = node.row + moves[i].dr;
+          int nc = node.col + moves[i].dc;
+          if ((borders & moves[i].border) || laby_bfs_is_visited (bfs, nr, nc))
+            continue;
+          /* the move to the start keeps the estimation */
+          _Bool closer = abs (nr - r) + abs (nc - c) < distance;
+          if (push (solver, closer ? current : !current, nr, nc, i ^ 1) != 0)
+            return -2;
+        }
+    }
+}
+
+_Bool
+laby_solver_next_room (const Laby_Solver *solver, int *r, int *c)
+{
+  const Laby_Bfs *bfs = &solver->bfs;
+  if ((*r == solver->row && *c == solver->col)
+      || !laby_bfs_is_visited (bfs, *r, *c))
+    return 0;
+  const uint64_t *next = &solver->next[2 * laby_bfs_block (bfs, *r, *c)];
+  int bit = laby_bfs_bit (*r, *c);
+  int i = (next[0] >> bit & 1) | (next[1] >> bit & 1) << 1;
+  *r += moves[i].dr;
+  *c += moves[i].dc;
+  return 1;
+}
@@ -0,0 +1,72 @@
+#ifndef __LABY_SOLVER__
+#define __LABY_SOLVER__
+
+#include "laby.h"
+#include "laby_bfs.h"
+
+/* The room in the queue of the solver */
+typedef struct
+{
+  int row;
+  int col;
+  /* The index of the move from the room toward the target, it's ignored
+   * for the target itself */
+  int next;
+} Laby_Solver_Node;
+
+/**
+ * The A* search of the shortest path with the Manhattan distance as the
+ * heuristic. The search goes from the target to the start, so every closed
+ * room keeps the border on the shortest path to the target, and the path is
+ * followed forward without reversing.
+ *
+ * Every move changes the estimation of the path by 0 or 2 steps, so the
+ * queue is two stacks: rooms with the current estimation and rooms with the
+ * next one. The stacks grow by doubling and are kept between searches, as
+ * the copy of borders and the closed rooms in the Laby_Bfs, so there are no
+ * allocations per room.
+ *
+ * Closed rooms are kept until the next search to another target, or from
+ * the room which is not closed. So the solver is built once per labyrinth,
+ * and the path to the same target is followed without a search, while the
+ * player goes along it.
+ */
+typedef struct
+{
+  /* The borders and the closed rooms */
+  Laby_Bfs bfs;
+  /* The index of the move toward the target from every closed room, by
+   * two bitsets of its bits per block of the bfs */
+  uint64_t *next;
+  /* The target of the last search, or -1 before the first one */
+  int row;
+  int col;
+  Laby_Solver_Node *open[2];
+  long open_count[2];
+  long open_size[2];
+} Laby_Solver;
+
+/**
+ * Copies borders of the labyrinth. The LL_RING labyrinth is not supported.
+ * Returns 0 on success, or -1 and sets errno, when the memory can't be
+ * allocated.
+ */
+int laby_solver_init (Laby_Solver *solver, const Laby *lab);
+
+void laby_solver_free (Laby_Solver *solver);
+
+/**
+ * Finds the shortest path from the room r:c to the room tr:tc. Returns its
+ * count of steps, -1 when the target can't be reached, or -2 and sets errno,
+ * when the memory for the queue can't be allocated. The path from the room
+ * closed by the last search to the same target is taken without a search.
+ */
+long laby_solve (Laby_Solver *solver, int r, int c, int tr, int tc);
+
+/**
+ * Moves r:c to the next room of the path found by the last laby_solve.
+ * Returns 0 when r:c is the target, or is not on the closed path.
+ */
+_Bool laby_solver_next_room (const Laby_Solver *solver, int *r, int *c);
+
+#endif /* __LABY_SOLVER__ */
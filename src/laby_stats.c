@@ -0,0 +1,272 @@
+/**
+ * The analysis of labyrinths: counts of special rooms, corridors and lengths
+ * of paths.
+ */
+#include "laby_stats.h"
+#include "laby_bfs.h"
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The moves from the room through every of its borders */
+static const struct
+{
+  enum border border;
+  enum border opposite;
+  int dr;
+  int dc;
+} moves[] = { { UPPER_BORDER, BOTTOM_BORDER, -1, 0 },
+              { BOTTOM_BORDER, UPPER_BORDER, 1, 0 },
+              { LEFT_BORDER, RIGHT_BORDER, 0, -1 },
+              { RIGHT_BORDER, LEFT_BORDER, 0, 1 } };
+
+/* Returns 1 when the room r:c is in the bitset of blocks of the search */
+static inline _Bool
+has_room (const Laby_Bfs *bfs, const uint64_t *rooms, int r, int c)
+{
+  return (rooms[laby_bfs_block (bfs, r, c)] >> laby_bfs_bit (r, c)) & 1;
+}
+
+/**
+ * Goes along the corridor from its first room r:c, which was entered
+ * through the border `from`. Returns the count of rooms of the corridor, and
+ * the last room of it in r:c.
+ */
+static long
+walk_corridor (const Laby_Bfs *bfs, const uint64_t *corridors, int *r,
+               int *c, enum border from)
+{
+  long length = 1;
+  while (1)
+    {
+      unsigned char borders = laby_bfs_borders (bfs, *r, *c) | from;
+      int i = 0;
+      while (borders & moves[i].border)
+        i++;
+      int nr = *r + moves[i].dr;
+      int nc = *c + moves[i].dc;
+      if (!has_room (bfs, corridors, nr, nc))
+        return length;
+      *r = nr;
+      *c = nc;
+      from = moves[i].opposite;
+      length++;
+    }
+}
+
+/**
+ * Counts dead ends, junctions and corridors. The borders of 64 rooms are
+ * summed at once by bitwise adders. Every corridor is walked from both its
+ * ends, and is counted from the end with the less index. Returns -1 when
+ * the memory can't be allocated.
+ */
+static int
+count_rooms (const Laby_Bfs *bfs, Laby_Stats *stats)
+{
+  /* the rooms with two passages */
+  uint64_t *corridors = malloc (sizeof (uint64_t) * bfs->blocks_count);
+  if (corridors == NULL)
+    {
+      errno = ENOMEM;
+      return -1;
+    }
+  for (long w = 0; w < bfs->blocks_count; w++)
+    {
+      uint64_t right = bfs->blocks[w].right;
+      uint64_t left = laby_bfs_left_borders (bfs, w);
+      uint64_t bottom = bfs->blocks[w].bottom;
+      uint64_t upper = laby_bfs_upper_borders (bfs, w);
+
+      /* the count of borders is fours x 4 + twos x 2 + ones. The rooms
+       * after the last row and column have four borders, and are not
+       * counted. */
+      uint64_t ones = right ^ left ^ bottom ^ upper;
+      uint64_t carry = (right ^ left) & (bottom ^ upper);
+      uint64_t twos = (right & left) ^ (bottom & upper) ^ carry;
+      uint64_t fours = right & left & bottom & upper;
+
+      stats->dead_ends += __builtin_popcountll (ones & twos);
+      stats->junctions += __builtin_popcountll (~twos & ~fours);
+      corridors[w] = ~ones & twos & ~fours;
+    }
+
+  for (long w = 0; w < bfs->blocks_count; w++)
+    for (uint64_t bits = corridors[w]; bits; bits &= bits - 1)
+      {
+        int bit = __builtin_ctzll (bits);
+        int r = w / bfs->blocks_cols * 8 + bit / 8;
+        int c = w % bfs->blocks_cols * 8 + bit % 8;
+        unsigned char borders = laby_bfs_borders (bfs, r, c);
+        /* the end of the corridor has a passage to other room */
+        for (int i = 0; i < 4; i++)
+          if (!(borders & moves[i].border)
+              && !has_room (bfs, corridors, r + moves[i].dr,
+                            c + moves[i].dc))
+            {
+              int er = r, ec = c;
+              long length
+                  = walk_corridor (bfs, corridors, &er, &ec, moves[i].border);
+              if ((long)r * bfs->cols + c <= (long)er * bfs->cols + ec)
+                stats->corridors[(length < LABY_STATS_CORRIDORS)
+                                     ? length - 1
+                                     : LABY_STATS_CORRIDORS - 1]++;
+              break;
+            }
+      }
+  free (corridors);
+  return 0;
+}
+
+/* The rooms at one distance from the start of the search */
+typedef struct
+{
+  long count;
+  /* the room chosen among them, when the search chooses rooms */
+  int row;
+  int col;
+} Level;
+
+/**
+ * Searches from the room r:c and returns the count of distances to the
+ * reachable rooms, and the rooms at every distance in `levels`, which must
+ * be freed. When `choose` is true, the room `pick` modulo the count is
+ * taken at every distance. Returns -1 when the memory can't be allocated.
+ */
+static long
+search_levels (const Laby *lab, int r, int c, _Bool choose, uint64_t pick,
+               Level **levels)
+{
+  Laby_Bfs bfs;
+  if (laby_bfs_init (&bfs, lab, 0) != 0)
+    return -1;
+
+  long size = 64;
+  *levels = malloc (sizeof (Level) * size);
+  long steps = 0;
+  laby_bfs_start (&bfs, r, c);
+  do
+    {
+      if (*levels != NULL && steps == size)
+        {
+          Level *grown = realloc (*levels, sizeof (Level) * (size *= 2));
+          if (grown == NULL)
+            free (*levels);
+          *levels = grown;
+        }
+      if (*levels == NULL)
+        {
+          laby_bfs_free (&bfs);
+          errno = ENOMEM;
+          return -1;
+        }
+      Level *level = &(*levels)[steps++];
+      level->count = laby_bfs_front_size (&bfs);
+      if (choose)
+        laby_bfs_front_room (&bfs, pick % level->count, &level->row,
+                             &level->col);
+    }
+  while (laby_bfs_step (&bfs));
+
+  laby_bfs_free (&bfs);
+  return steps;
+}
+
+/* Returns the least distance of the levels with the percent of rooms */
+static long
+percentile_distance (const Level *levels, long steps, int percentile)
+{
+  long total = 0;
+  for (long i = 0; i < steps; i++)
+    total += levels[i].count;
+  long needed = (total * percentile + 99) / 100;
+  long distance = 0;
+  for (long sum = levels[0].count; sum < needed && distance + 1 < steps;)
+    sum += levels[++distance].count;
+  return distance;
+}
+
+long
+laby_distance_percentile (const Laby *lab, int r, int c, int percentile)
+{
+  Level *levels;
+  long steps = search_levels (lab, r, c, 0, 0, &levels);
+  if (steps < 0)
+    return -1;
+  long distance = percentile_distance (levels, steps, percentile);
+  free (levels);
+  return distance;
+}
+
+int
+laby_choose_room_at_percentile (const Laby *lab, int r, int c,
+                                int percentile, long min_distance,
+                                lcg *seed, int *rr, int *rc)
+{
+  /* the same number as laby_choose_room_at_distance would take */
+  uint64_t pick = lcg_rand (seed);
+  Level *levels;
+  long steps = search_levels (lab, r, c, 1, pick, &levels);
+  if (steps < 0)
+    return -1;
+  long distance = percentile_distance (levels, steps, percentile);
+  distance = (distance > min_distance) ? distance : min_distance;
+  /* the farthest rooms are taken, when there are no rooms so far */
+  distance = (distance < steps) ? distance : steps - 1;
+  *rr = levels[distance].row;
+  *rc = levels[distance].col;
+  free (levels);
+  return 0;
+}
+
+int
+laby_choose_room_at_distance (const Laby *lab, int r, int c, long distance,
+                              lcg *seed, int *rr, int *rc)
+{
+  Laby_Bfs bfs;
+  if (laby_bfs_init (&bfs, lab, 0) != 0)
+    return -1;
+  /* the farthest rooms are left in the front, when there are no rooms so
+   * far */
+  laby_bfs_run (&bfs, r, c, -1, -1, distance);
+  laby_bfs_front_room (&bfs, lcg_rand (seed) % laby_bfs_front_size (&bfs),
+                       rr, rc);
+  laby_bfs_free (&bfs);
+  return 0;
+}
+
+int
+laby_compute_stats (const Laby *lab, Laby_Stats *stats)
+{
+  assert (lab->layout != LL_RING);
+  memset (stats, 0, sizeof (Laby_Stats));
+  stats->exit_distance = -1;
+  if (lab->rows == 0 || lab->cols == 0)
+    return 0;
+
+  Laby_Bfs bfs;
+  int r, c;
+  if (laby_bfs_init (&bfs, lab, 0) != 0)
+    return -1;
+  if (count_rooms (&bfs, stats) != 0)
+    {
+      laby_bfs_free (&bfs);
+      return -1;
+    }
+  laby_bfs_run (&bfs, 0, 0, -1, -1, -1);
+  laby_bfs_front_room (&bfs, 0, &r, &c);
+  stats->diameter = laby_bfs_run (&bfs, r, c, -1, -1, -1);
+
+  const Laby_Content *player = NULL;
+  const Laby_Content *exit_room = NULL;
+  for (int i = 0; i < lab->content_count; i++)
+    if (lab->content[i].content == C_PLAYER)
+      player = &lab->content[i];
+    else if (lab->content[i].content == C_EXIT)
+      exit_room = &lab->content[i];
+  if (player && exit_room)
+    stats->exit_distance = laby_bfs_run (&bfs, player->row, player->col,
+                                         exit_room->row, exit_room->col, -1);
+  laby_bfs_free (&bfs);
+  return 0;
+}
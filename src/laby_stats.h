@@ -0,0 +1,70 @@
+#ifndef __LABY_STATS__
+#define __LABY_STATS__
+
+#include "laby.h"
+
+/* The count of buckets of the histogram of corridor lengths */
+#define LABY_STATS_CORRIDORS 16
+
+/**
+ * The metrics of the labyrinth. Passages are counted only between rooms of
+ * the labyrinth.
+ */
+typedef struct
+{
+  /* The count of rooms with a single passage */
+  long dead_ends;
+  /* The count of rooms with three or four passages */
+  long junctions;
+  /* The count of corridors of i + 1 rooms in the bucket i. A corridor is
+   * the longest chain of rooms with two passages. The last bucket counts
+   * all longer corridors. Corridors closed in a ring are not counted. */
+  long corridors[LABY_STATS_CORRIDORS];
+  /* The count of steps of the longest shortest path, which is found by two
+   * searches: the farthest room from the first room, and the farthest room
+   * from that one. It's exact for perfect labyrinths, and a lower bound
+   * for labyrinths with cycles. */
+  long diameter;
+  /* The count of steps from the player to the exit, or -1 when the player or
+   * the exit is absent, or the exit is not reachable */
+  long exit_distance;
+} Laby_Stats;
+
+/**
+ * Computes the metrics of the labyrinth. The rooms are counted and searched
+ * over bitsets of 8x8 rooms (see laby_bfs.h), which take about 5 bits of
+ * memory per room.
+ * Returns 0 on success, or -1 and sets errno, when the memory can't be
+ * allocated. The LL_RING labyrinth is not supported.
+ */
+int laby_compute_stats (const Laby *lab, Laby_Stats *stats);
+
+/**
+ * Returns the least count of steps from the room r:c, which is enough to
+ * reach `percentile` percents of the rooms reachable from r:c. As other
+ * functions here, it takes linear time. Returns -1 and sets errno, when the
+ * memory can't be allocated. The LL_RING labyrinth is not supported.
+ */
+long laby_distance_percentile (const Laby *lab, int r, int c, int percentile);
+
+/**
+ * Chooses a room at the distance of laby_distance_percentile from the room
+ * r:c, but not less than `min_distance` steps, by the seed. It runs a single
+ * search, and the room is the same as laby_choose_room_at_distance chooses
+ * after laby_distance_percentile. Returns 0 on success, or -1 and sets
+ * errno, when the memory can't be allocated.
+ */
+int laby_choose_room_at_percentile (const Laby *lab, int r, int c,
+                                    int percentile, long min_distance,
+                                    lcg *seed, int *rr, int *rc);
+
+/**
+ * Chooses a room in `distance` steps from the room r:c by the seed. One of
+ * the farthest rooms is chosen, when the labyrinth doesn't have rooms so far.
+ * Returns 0 on success, or -1 and sets errno, when the memory can't be
+ * allocated.
+ */
+int laby_choose_room_at_distance (const Laby *lab, int r, int c,
+                                  long distance, lcg *seed, int *rr, int *rc);
+
+#endif /* __LABY_STATS__ */
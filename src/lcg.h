@@ -9,6 +9,52 @@
 
 typedef uint64_t lcg;
 
-#define lcg_rand(seed) (*seed = *seed * 48271 % 0x7fffffff)
+#define LCG_MULTIPLIER 48271
+#define LCG_MODULUS 0x7fffffff
+
+#define lcg_rand(seed) (*seed = *seed * LCG_MULTIPLIER % LCG_MODULUS)
+
+/* Returns LCG_MULTIPLIER ^ n by modulus LCG_MODULUS */
+static inline uint64_t
+lcg_multiplier_pow (uint64_t n)
+{
+  uint64_t result = 1;
+  uint64_t base = LCG_MULTIPLIER;
+  for (; n > 0; n >>= 1)
+    {
+      if (n & 1)
+        result = result * base % LCG_MODULUS;
+      base = base * base % LCG_MODULUS;
+    }
+  return result;
+}
+
+/**
+ * Advances the seed by n steps in O(log n), as n calls of lcg_rand would do.
+ * The products are less than 2^62, because the state after the first step
+ * is less than the modulus.
+ */
+static inline void
+lcg_skip (lcg *seed, uint64_t n)
+{
+  if (n == 0)
+    return;
+  lcg_rand (seed);
+  *seed = *seed * lcg_multiplier_pow (n - 1) % LCG_MODULUS;
+}
+
+/**
+ * Splits the next n numbers of the sequence to the separate stream, and
+ * skips them in the seed. The stream gives the same numbers as the seed
+ * would give; streams split one by one never overlap, if every stream takes
+ * not more than its n numbers.
+ */
+static inline lcg
+lcg_split (lcg *seed, uint64_t n)
+{
+  lcg stream = *seed;
+  lcg_skip (seed, n);
+  return stream;
+}
 
 #endif // __LCG__
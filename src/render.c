@@ -23,6 +23,7 @@ static const char *s_player = "@";
 static const char *s_marker = "X";
 static const char *s_exit = "⛿";
 static const char *s_light = "·";
+static const char *s_hint = "•";
 
 /* Symbols to render borders */
 //       0    1    2    3    4    5    6    7    8    9    10
@@ -56,7 +57,7 @@ create_menu (enum game_state state)
     }
 
   if (state == ST_CMD)
-    menu->cmd = malloc (sizeof (char) * MAX_CMD_LENGTH);
+    menu->cmd = calloc (MAX_CMD_LENGTH, sizeof (char));
 
   return menu;
 }
@@ -241,6 +242,7 @@ render_room (Render *render, Laby *lab, int r, int c, int y, int x,
           : (ct == C_PLAYER && mode == DLM_REGULAR)      ? s_player
           : (ct == C_PLAYER && mode == DLM_MAP)          ? s_marker
           : (ct == C_EXIT)                               ? s_exit
+          : (ct == C_HINT)                               ? s_hint
           : (need_draw_light_for_room (lab, r, c, mode)) ? s_light
                                                          : s_empty;
     }
@@ -423,6 +425,60 @@ render_winning (Render *render, Game *game)
   u8_buffer_free (&label);
 }
 
+static void
+render_generating (Render *render, Game *game)
+{
+  static const char spinner[] = "|/-\\";
+  char msg[40];
+  int len = sprintf (msg, "Generating the labyrinth %c",
+                     spinner[game->waiting_frames % 4]);
+  u8buf frame = U8_BUF_EMPTY;
+  u8buf label = U8_BUF_EMPTY;
+  create_frame (&frame, 5, 40);
+  u8_buffer_add_line (&label, msg, len);
+  u8_buffer_merge (&frame, &label, 2, 7);
+  u8_buffer_merge (&render->buf, &frame, 10, 19);
+  u8_buffer_free (&frame);
+  u8_buffer_free (&label);
+}
+
+static void
+render_stats (Render *render, Laby_Stats *stats)
+{
+  char line[60];
+  int len;
+  u8buf frame = U8_BUF_EMPTY;
+  u8buf label = U8_BUF_EMPTY;
+  create_frame (&frame, 13, 56);
+
+  len = sprintf (line, "Dead ends: %ld    Junctions: %ld", stats->dead_ends,
+                 stats->junctions);
+  u8_buffer_add_line (&label, line, len);
+  len = sprintf (line, "Diameter: %ld    Steps to the exit: %ld",
+                 stats->diameter, stats->exit_distance);
+  u8_buffer_add_line (&label, line, len);
+  u8_buffer_add_line (&label, "", 0);
+  len = sprintf (line, "Corridors by length:");
+  u8_buffer_add_line (&label, line, len);
+  for (int i = 0; i < LABY_STATS_CORRIDORS; i += 4)
+    {
+      len = 0;
+      for (int j = i; j < i + 4; j++)
+        len += sprintf (line + len, "%2d%c: %-7ld ", j + 1,
+                        (j == LABY_STATS_CORRIDORS - 1) ? '+' : ' ',
+                        stats->corridors[j]);
+      u8_buffer_add_line (&label, line, len);
+    }
+  u8_buffer_add_line (&label, "", 0);
+  len = sprintf (line, "Press any key to continue");
+  u8_buffer_add_line (&label, line, len);
+
+  u8_buffer_merge (&frame, &label, 1, 3);
+  u8_buffer_merge (&render->buf, &frame, 5, 11);
+  u8_buffer_free (&frame);
+  u8_buffer_free (&label);
+}
+
 static void
 render_cmd (Render *render, char *cmd, int len)
 {
@@ -496,6 +552,13 @@ render (Render *render, Game *game)
     case ST_WIN:
       render_winning (render, game);
       break;
+    case ST_GENERATING:
+      render_generating (render, game);
+      break;
+    case ST_STATS:
+      render_level (render, game, GAME_PREV_STATE);
+      render_stats (render, &game->stats);
+      break;
     }
 
   /* padding of the visible game screen and terminal window */
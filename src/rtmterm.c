@@ -79,6 +79,21 @@ parse_cmd (char *cmd, int len)
   if (strcmp (cmd, "new game") == 0)
     return CMD_NEW_GAME;
 
+  if (strcmp (cmd, "save") == 0)
+    return CMD_SAVE;
+
+  if (strcmp (cmd, "load") == 0)
+    return CMD_LOAD;
+
+  if (strcmp (cmd, "stats") == 0)
+    return CMD_SHOW_STATS;
+
+  if (strcmp (cmd, "solve") == 0)
+    return CMD_SOLVE;
+
+  if (strcmp (cmd, "hint") == 0)
+    return CMD_HINT;
+
   return CMD_CONTINUE;
 }
 
@@ -163,6 +178,14 @@ read_command (Game *game)
           }
       }
 
+    case ST_GENERATING:
+      return CMD_NOTHING;
+
+    case ST_STATS:
+      /* any key closes the metrics */
+      read_key ();
+      return CMD_CONTINUE;
+
     case ST_KEY_SETTINGS:
       {
         enum key key = read_key ();
@@ -192,13 +215,15 @@ read_command (Game *game)
                 return parse_cmd (M->cmd, M->options_count);
               case KB_BACKSPACE:
                 if (M->options_count > 0)
-                  M->options_count--;
+                  M->cmd[--M->options_count] = '\0';
                 return CMD_NOTHING;
               default:
-                if (M->options_count < MAX_CMD_LENGTH)
+                /* the command is kept as the string for parse_cmd */
+                if (M->options_count < MAX_CMD_LENGTH - 1)
                   {
                     M->cmd[M->options_count] = k.chars[0];
                     M->options_count++;
+                    M->cmd[M->options_count] = '\0';
                   }
                 return CMD_NOTHING;
               }
@@ -150,10 +150,14 @@ u8_str_merge (u8str *dest, const u8str *source, int spad)
       /* in this case we have a small appendix at the end of the destination,
        * which should be moved right after the inserted source string */
       int aplen = dest->length - ex;
-      dest->length = sx + source->length + aplen;
-      dest->chars = realloc (dest->chars, dest->length);
-      memcpy (&dest->chars[sx + source->length], &dest->chars[ex], aplen);
+      int length = sx + source->length + aplen;
+      /* the string is not shrunk before the appendix is moved */
+      if (length > dest->length)
+        dest->chars = realloc (dest->chars, length);
+      /* the old and new places of the appendix can overlap */
+      memmove (&dest->chars[sx + source->length], &dest->chars[ex], aplen);
       memcpy (&dest->chars[sx], source->chars, source->length);
+      dest->length = length;
     }
 }
 
@@ -266,7 +270,7 @@ u8_buffer_end_line (u8buf *buf)
 void
 u8_buffer_parse (u8buf *buf, const char *str)
 {
-  char *s = malloc (sizeof (char) * strlen (str));
+  char *s = malloc (sizeof (char) * (strlen (str) + 1));
   strcpy (s, str);
 
   char *next = strtok (s, "\r\n");
@@ -1,4 +1,12 @@
+#include "laby_helpers.h"
 #include "2d_math_tests.c"
+#include "laby_tests.c"
+#include "laby_bfs_tests.c"
+#include "laby_cache_tests.c"
+#include "laby_gen_tests.c"
+#include "laby_solver_tests.c"
+#include "laby_stats_tests.c"
+#include "lcg_tests.c"
 #include "render_tests.c"
 #include "term.h"
 #include "u8_tests.c"
@@ -16,12 +24,17 @@ all_tests ()
   mu_run_test (parallel_lines_intersection_test);
   mu_run_test (perpendicular_lines_intersection_test);
   mu_run_test (lines_intersection_test_1);
+  /* lcg tests */
+  mu_run_test (lcg_skip_test);
+  mu_run_test (lcg_skip_big_seed_test);
+  mu_run_test (lcg_split_test);
   /* str tests */
   mu_run_test (utf8_find_index_test);
   mu_run_test (utf8_symbols_count_test);
   mu_run_test (utf8_find_symbol_test);
   mu_run_test (utf8_str_merge_1_test);
   mu_run_test (utf8_str_merge_2_test);
+  mu_run_test (utf8_str_merge_shifted_appendix_test);
   mu_run_test (utf8_merge_into_empty_str_test);
   mu_run_test (utf8_str_crop_test_1);
   mu_run_test (utf8_str_crop_test_2);
@@ -29,6 +42,7 @@ all_tests ()
   mu_run_test (utf8_str_crop_test_4);
   /* buffer tests */
   mu_run_test (parse_string_to_buffer_test);
+  mu_run_test (parse_many_strings_to_buffer_test);
   mu_run_test (merge_into_empty_buffers_test);
   mu_run_test (merge_middle_buffer_test);
   mu_run_test (merge_bigger_buffer_test);
@@ -36,6 +50,38 @@ all_tests ()
   mu_run_test (crop_utf_buffer_test);
   mu_run_test (fill_utf_buffer_test);
   // /* laby tests */
+  mu_run_test (laby_memory_footprint_test);
+  mu_run_test (laby_fill_rect_test);
+  mu_run_test (laby_outer_borders_test);
+  mu_run_test (laby_tiles_layout_test);
+  mu_run_test (laby_giant_tiles_test);
+  mu_run_test (laby_endless_ring_test);
+  mu_run_test (laby_file_test);
+  mu_run_test (laby_generate_file_test);
+  mu_run_test (laby_broken_file_test);
+  mu_run_test (laby_stream_test);
+  mu_run_test (laby_cache_test);
+  mu_run_test (laby_cache_broken_file_test);
+  mu_run_test (laby_cache_read_only_test);
+  mu_run_test (laby_cache_eviction_test);
+  mu_run_test (laby_wide_generation_test);
+  mu_run_test (laby_parallel_generation_test);
+  mu_run_test (laby_batched_generation_test);
+  mu_run_test (laby_chunks_generation_test);
+  mu_run_test (laby_batch_generation_test);
+  mu_run_test (laby_generators_test);
+  mu_run_test (laby_generators_too_big_test);
+  mu_run_test (laby_find_generator_test);
+  mu_run_test (laby_bfs_distances_test);
+  mu_run_test (laby_bfs_target_and_radius_test);
+  mu_run_test (laby_solve_test);
+  mu_run_test (laby_solve_unreachable_test);
+  mu_run_test (laby_solve_same_target_test);
+  mu_run_test (laby_stats_of_corridor_test);
+  mu_run_test (laby_stats_test);
+  mu_run_test (laby_distance_percentile_test);
+  mu_run_test (laby_choose_room_at_distance_test);
+  mu_run_test (laby_choose_room_at_percentile_test);
   mu_run_test (empty_laby_test);
   mu_run_test (simple_laby_test);
   mu_run_test (generate_eller_test);
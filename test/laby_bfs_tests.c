@@ -0,0 +1,108 @@
+#include "laby_bfs.h"
+#include "laby_gen.h"
+#include "minunit.h"
+
+/* reference_distances is in laby_helpers.h */
+
+static char *
+laby_bfs_distances_test ()
+{
+  int sizes[][2] = { { 70, 150 }, { 13, 29 }, { 1, 9 }, { 64, 64 } };
+  const char *generators[] = { "eller", "backtracker", "kruskal" };
+  for (int s = 0; s < 4; s++)
+    for (int g = 0; g < 3; g++)
+      {
+        // given:
+        int rows = sizes[s][0];
+        int cols = sizes[s][1];
+        lcg seed = 1904;
+        Laby lab;
+        laby_find_generator (generators[g])
+            ->generate (&lab, rows, cols, &seed);
+        Laby_Bfs bfs;
+        mu_assert ("The memory of the search should be allocated",
+                   laby_bfs_init (&bfs, &lab, 1) == 0);
+        int starts[] = { 0, rows * cols / 2 + cols / 3, rows * cols - 1 };
+
+        for (int k = 0; k < 3; k++)
+          {
+            // when:
+            long far = laby_bfs_run (&bfs, starts[k] / cols, starts[k] % cols,
+                                     -1, -1, -1);
+
+            // then:
+            int *dist = reference_distances (&lab, starts[k]);
+            int max = 0;
+            for (int i = 0; i < rows * cols; i++)
+              {
+                int r = i / cols, c = i % cols;
+                mu_assert ("The borders should be the same as in labyrinth",
+                           laby_bfs_borders (&bfs, r, c)
+                               == laby_get_borders (&lab, r, c));
+                mu_assert ("Wrong distance to the room",
+                           laby_bfs_distance (&bfs, r, c) == dist[i]);
+                max = (dist[i] > max) ? dist[i] : max;
+              }
+            mu_assert ("The farthest rooms should be at the end",
+                       far == max);
+            for (long j = 0; j < laby_bfs_front_size (&bfs); j++)
+              {
+                int r, c;
+                laby_bfs_front_room (&bfs, j, &r, &c);
+                mu_assert ("The front should have the farthest rooms",
+                           dist[r * cols + c] == max);
+              }
+            free (dist);
+          }
+        laby_bfs_free (&bfs);
+        laby_free (&lab);
+      }
+  return 0;
+}
+
+static char *
+laby_bfs_target_and_radius_test ()
+{
+  // given:
+  int rows = 50;
+  int cols = 130;
+  lcg seed = 1904;
+  Laby lab;
+  laby_find_generator ("backtracker")->generate (&lab, rows, cols, &seed);
+  Laby_Bfs bfs;
+  laby_bfs_init (&bfs, &lab, 1);
+  int *dist = reference_distances (&lab, 20 * cols + 65);
+
+  // when:
+  long to_target = laby_bfs_run (&bfs, 20, 65, 49, 0, -1);
+
+  // then:
+  mu_assert ("Wrong distance to the target",
+             to_target == dist[49 * cols + 0]);
+  long visited = 0;
+  for (int i = 0; i < rows * cols; i++)
+    visited += laby_bfs_is_visited (&bfs, i / cols, i % cols);
+  mu_assert ("The search should be stopped at the target",
+             visited < (long)rows * cols);
+
+  // when:
+  long to_far = laby_bfs_run (&bfs, 20, 65, 49, 0, to_target - 1);
+
+  // then:
+  mu_assert ("The target should not be reached out of the radius",
+             to_far == -1);
+  for (int i = 0; i < rows * cols; i++)
+    {
+      mu_assert ("Only rooms in the radius should be visited",
+                 laby_bfs_is_visited (&bfs, i / cols, i % cols)
+                     == (dist[i] >= 0 && dist[i] < to_target));
+      mu_assert ("Distances in the radius should be the same",
+                 laby_bfs_distance (&bfs, i / cols, i % cols)
+                     == ((dist[i] < to_target) ? dist[i] : -1));
+    }
+
+  free (dist);
+  laby_bfs_free (&bfs);
+  laby_free (&lab);
+  return 0;
+}
@@ -0,0 +1,207 @@
+#include "laby.h"
+#include "laby_cache.h"
+#include "minunit.h"
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Returns the count of files in the directory, or removes them all */
+static int
+cache_files (const char *dir, _Bool remove)
+{
+  DIR *d = opendir (dir);
+  struct dirent *e;
+  char path[PATH_MAX];
+  int count = 0;
+  while ((e = readdir (d)) != NULL)
+    if (e->d_name[0] != '.')
+      {
+        count++;
+        snprintf (path, PATH_MAX, "%s/%s", dir, e->d_name);
+        if (remove)
+          unlink (path);
+      }
+  closedir (d);
+  if (remove)
+    rmdir (dir);
+  return count;
+}
+
+static char *
+laby_cache_test ()
+{
+  // given:
+  int rows = 70;
+  int cols = 150;
+  lcg seed = 1904;
+  Laby expected, actual;
+  laby_generate (&expected, rows, cols, &seed);
+  char dir[] = "/tmp/laby_cache_test_XXXXXX";
+  mkdtemp (dir);
+  Laby_Cache cache;
+  mu_assert ("The cache should be opened",
+             laby_cache_open (&cache, dir, LABY_CACHE_MAX_SIZE) == 0);
+
+  // when:
+  lcg loaded_seed = 1904;
+  mu_assert ("The absent labyrinth should not be loaded",
+             laby_cache_load (&cache, "eller", &loaded_seed, rows, cols,
+                              &actual)
+                 == -1);
+  mu_assert ("The labyrinth should be stored",
+             laby_cache_store (&cache, "eller", 1904, seed, &expected) == 0);
+  mu_assert ("The labyrinth should be loaded",
+             laby_cache_load (&cache, "eller", &loaded_seed, rows, cols,
+                              &actual)
+                 == 0);
+
+  // then:
+  mu_assert ("The seed should be the same as after the generation",
+             loaded_seed == seed);
+  for (int r = -1; r <= rows; r++)
+    for (int c = -1; c <= cols; c++)
+      mu_assert ("Borders should be the same as in the stored labyrinth",
+                 laby_get_borders (&expected, r, c)
+                     == laby_get_borders (&actual, r, c));
+  laby_free (&actual);
+  loaded_seed = 1904;
+  mu_assert ("The labyrinth of other generator should not be loaded",
+             laby_cache_load (&cache, "kruskal", &loaded_seed, rows, cols,
+                              &actual)
+                 == -1);
+  mu_assert ("The labyrinth of other size should not be loaded",
+             laby_cache_load (&cache, "eller", &loaded_seed, rows, cols + 1,
+                              &actual)
+                 == -1);
+  mu_assert ("The seed should not be changed by the miss",
+             loaded_seed == 1904);
+  laby_free (&expected);
+  cache_files (dir, 1);
+  return 0;
+}
+
+static char *
+laby_cache_broken_file_test ()
+{
+  // given:
+  lcg seed = 1904;
+  Laby lab;
+  laby_generate (&lab, 70, 150, &seed);
+  char dir[] = "/tmp/laby_cache_test_XXXXXX";
+  mkdtemp (dir);
+  Laby_Cache cache;
+  laby_cache_open (&cache, dir, LABY_CACHE_MAX_SIZE);
+  laby_cache_store (&cache, "eller", 1904, seed, &lab);
+  laby_free (&lab);
+
+  // when:
+  char path[PATH_MAX];
+  snprintf (path, PATH_MAX, "%s/eller-v%d-1904-70x150.laby", dir,
+            LABY_GENERATORS_VERSION);
+  FILE *f = fopen (path, "r+b");
+  mu_assert ("The file should be named by the key", f != NULL);
+  fseek (f, 1000, SEEK_SET);
+  int b = getc (f);
+  fseek (f, 1000, SEEK_SET);
+  putc (b ^ 4, f);
+  fclose (f);
+
+  // then:
+  lcg loaded_seed = 1904;
+  mu_assert ("The broken labyrinth should not be loaded",
+             laby_cache_load (&cache, "eller", &loaded_seed, 70, 150, &lab)
+                 == -1);
+  mu_assert ("The broken file should be removed",
+             cache_files (dir, 0) == 0);
+  cache_files (dir, 1);
+  return 0;
+}
+
+static char *
+laby_cache_read_only_test ()
+{
+  // given:
+  lcg seed = 1904;
+  Laby lab;
+  laby_generate (&lab, 70, 150, &seed);
+  char dir[] = "/tmp/laby_cache_test_XXXXXX";
+  mkdtemp (dir);
+  Laby_Cache cache;
+  laby_cache_open (&cache, dir, LABY_CACHE_MAX_SIZE);
+  laby_cache_store (&cache, "eller", 1904, seed, &lab);
+  laby_free (&lab);
+  /* the test can be run by root, who writes to any directory */
+  cache.read_only = 1;
+
+  // when:
+  lcg other_seed = 1905;
+  laby_generate (&lab, 70, 150, &other_seed);
+  int res = laby_cache_store (&cache, "eller", 1905, other_seed, &lab);
+  laby_free (&lab);
+
+  // then:
+  mu_assert ("The read-only cache should not store labyrinths",
+             res == -1 && errno == EROFS && cache_files (dir, 0) == 1);
+  lcg loaded_seed = 1904;
+  mu_assert ("The read-only cache should load labyrinths",
+             laby_cache_load (&cache, "eller", &loaded_seed, 70, 150, &lab)
+                 == 0);
+  laby_free (&lab);
+  cache_files (dir, 1);
+  return 0;
+}
+
+static char *
+laby_cache_eviction_test ()
+{
+  // given:
+  int rows = 64;
+  int cols = 64;
+  char dir[] = "/tmp/laby_cache_test_XXXXXX";
+  mkdtemp (dir);
+  /* a bit more than two labyrinths */
+  long size = 48 + sizeof (uint64_t) * laby_packed_words (rows, cols);
+  Laby_Cache cache;
+  laby_cache_open (&cache, dir, 2 * size + size / 2);
+  Laby lab;
+  for (lcg s = 1; s <= 2; s++)
+    {
+      lcg seed = s;
+      laby_generate (&lab, rows, cols, &seed);
+      laby_cache_store (&cache, "eller", s, seed, &lab);
+      laby_free (&lab);
+      /* times of files are changed by ticks, which are not so short */
+      char path[PATH_MAX];
+      snprintf (path, PATH_MAX, "%s/eller-v%d-%d-%dx%d.laby", dir,
+                LABY_GENERATORS_VERSION, (int)s, rows, cols);
+      struct timespec used[2] = { { s, 0 }, { s, 0 } };
+      utimensat (AT_FDCWD, path, used, 0);
+    }
+
+  // when:
+  lcg seed = 1;
+  mu_assert ("The first labyrinth should be loaded",
+             laby_cache_load (&cache, "eller", &seed, rows, cols, &lab) == 0);
+  laby_free (&lab);
+  seed = 3;
+  laby_generate (&lab, rows, cols, &seed);
+  laby_cache_store (&cache, "eller", 3, seed, &lab);
+  laby_free (&lab);
+
+  // then:
+  mu_assert ("Only two labyrinths should be kept", cache_files (dir, 0) == 2);
+  seed = 2;
+  mu_assert ("The least recently used labyrinth should be removed",
+             laby_cache_load (&cache, "eller", &seed, rows, cols, &lab)
+                 == -1);
+  seed = 1;
+  mu_assert ("The recently used labyrinth should be kept",
+             laby_cache_load (&cache, "eller", &seed, rows, cols, &lab) == 0);
+  laby_free (&lab);
+  cache_files (dir, 1);
+  return 0;
+}
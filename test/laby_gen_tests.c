@@ -0,0 +1,69 @@
+#include "laby_gen.h"
+#include "minunit.h"
+#include <errno.h>
+
+/* count_reachable_rooms is in laby_helpers.h, count_passages is in
+ * laby_tests.c */
+
+static char *
+laby_generators_test ()
+{
+  int rows = 60;
+  int cols = 80;
+  for (int i = 0; i < laby_generators_count; i++)
+    {
+      // given:
+      lcg seed1 = 1904;
+      lcg seed2 = 1904;
+      Laby lab1, lab2;
+
+      // when:
+      laby_generators[i].generate (&lab1, rows, cols, &seed1);
+      laby_generators[i].generate (&lab2, rows, cols, &seed2);
+
+      // then:
+      mu_assert ("All rooms should be reachable",
+                 count_reachable_rooms (&lab1) == rows * cols);
+      /* the Eller's algorithm of this game can make a few loops */
+      if (strncmp (laby_generators[i].name, "eller", 5) != 0)
+        mu_assert ("The labyrinth should not have cycles",
+                   count_passages (&lab1) == rows * cols - 1);
+      for (int r = -1; r <= rows; r++)
+        for (int c = -1; c <= cols; c++)
+          mu_assert ("The same seed should give the same labyrinth",
+                     laby_get_borders (&lab1, r, c)
+                         == laby_get_borders (&lab2, r, c));
+      laby_free (&lab1);
+      laby_free (&lab2);
+    }
+  return 0;
+}
+
+static char *
+laby_generators_too_big_test ()
+{
+  // given:
+  Laby lab;
+
+  // when:
+  int kruskal = laby_generate_kruskal (&lab, 65536, 32769, NULL);
+  int kruskal_errno = errno;
+  int backtracker = laby_generate_backtracker (&lab, 65536, 65537, NULL);
+
+  // then:
+  mu_assert ("The walls of Kruskal's algorithm should not be cut to 32 bits",
+             kruskal == -1 && kruskal_errno == EOVERFLOW);
+  mu_assert ("The rooms of the backtracker should not be cut to 32 bits",
+             backtracker == -1 && errno == EOVERFLOW);
+  return 0;
+}
+
+static char *
+laby_find_generator_test ()
+{
+  mu_assert ("Known generator should be found",
+             laby_find_generator ("wilson")->generate == laby_generate_wilson);
+  mu_assert ("Unknown generator should not be found",
+             laby_find_generator ("prim") == NULL);
+  return 0;
+}
@@ -0,0 +1,55 @@
+#ifndef __LABY_TEST_HELPERS__
+#define __LABY_TEST_HELPERS__
+
+#include "laby.h"
+#include <stdlib.h>
+
+/**
+ * The reference breadth-first search room by room. Returns the count of
+ * steps from the room with the index `from` (row * cols + col) to every
+ * room, or -1 for rooms which can't be reached. The result should be freed.
+ */
+static int *
+reference_distances (const Laby *lab, long from)
+{
+  int cols = lab->cols;
+  long count = (long)lab->rows * cols;
+  int *dist = malloc (sizeof (int) * count);
+  long *queue = malloc (sizeof (long) * count);
+  for (long i = 0; i < count; i++)
+    dist[i] = -1;
+  long head = 0, tail = 0;
+  dist[from] = 0;
+  queue[tail++] = from;
+  while (head < tail)
+    {
+      long i = queue[head++];
+      unsigned char borders = laby_get_borders (lab, i / cols, i % cols);
+      long next[4][2] = { { UPPER_BORDER, i - cols },
+                          { BOTTOM_BORDER, i + cols },
+                          { LEFT_BORDER, i - 1 },
+                          { RIGHT_BORDER, i + 1 } };
+      for (int j = 0; j < 4; j++)
+        if (!(borders & next[j][0]) && dist[next[j][1]] < 0)
+          {
+            dist[next[j][1]] = dist[i] + 1;
+            queue[tail++] = next[j][1];
+          }
+    }
+  free (queue);
+  return dist;
+}
+
+/* Returns the count of rooms reachable from the room 0:0 */
+static long
+count_reachable_rooms (const Laby *lab)
+{
+  int *dist = reference_distances (lab, 0);
+  long count = 0;
+  for (long i = 0; i < (long)lab->rows * lab->cols; i++)
+    count += dist[i] >= 0;
+  free (dist);
+  return count;
+}
+
+#endif /* __LABY_TEST_HELPERS__ */
@@ -0,0 +1,121 @@
+#include "laby_gen.h"
+#include "laby_solver.h"
+#include "minunit.h"
+
+/* reference_distances is in laby_helpers.h */
+
+static char *
+laby_solve_test ()
+{
+  int rows = 70;
+  int cols = 150;
+  const char *generators[] = { "eller", "backtracker", "kruskal" };
+  int pairs[][4] = { { 0, 0, 69, 149 },
+                     { 35, 75, 35, 76 },
+                     { 69, 0, 3, 140 },
+                     { 10, 10, 10, 10 } };
+  for (int g = 0; g < 3; g++)
+    {
+      // given:
+      lcg seed = 1904;
+      Laby lab;
+      laby_find_generator (generators[g])
+          ->generate (&lab, rows, cols, &seed);
+      Laby_Solver solver;
+      laby_solver_init (&solver, &lab);
+
+      for (int k = 0; k < 4; k++)
+        {
+          int r = pairs[k][0], c = pairs[k][1];
+          int tr = pairs[k][2], tc = pairs[k][3];
+
+          // when:
+          long length = laby_solve (&solver, r, c, tr, tc);
+
+          // then:
+          int *dist = reference_distances (&lab, tr * cols + tc);
+          mu_assert ("The path should be the shortest one",
+                     length == dist[r * cols + c]);
+          long steps = 0;
+          while (laby_solver_next_room (&solver, &r, &c))
+            {
+              mu_assert ("Every step should be closer to the target",
+                         dist[r * cols + c] == length - ++steps);
+            }
+          mu_assert ("The path should end in the target",
+                     r == tr && c == tc && steps == length);
+          free (dist);
+        }
+      laby_solver_free (&solver);
+      laby_free (&lab);
+    }
+  return 0;
+}
+
+static char *
+laby_solve_unreachable_test ()
+{
+  // given:
+  Laby lab;
+  laby_init_empty (&lab, 3, 4);
+  /* the column of walls splits the labyrinth */
+  for (int r = 0; r < 3; r++)
+    laby_add_border (&lab, r, 1, RIGHT_BORDER);
+  Laby_Solver solver;
+  laby_solver_init (&solver, &lab);
+
+  // when:
+  long length = laby_solve (&solver, 0, 0, 2, 3);
+
+  // then:
+  mu_assert ("The target behind walls should not be reached", length == -1);
+  mu_assert ("The path should be found in the same part",
+             laby_solve (&solver, 0, 0, 2, 1) == 3);
+  laby_solver_free (&solver);
+  laby_free (&lab);
+  return 0;
+}
+
+static char *
+laby_solve_same_target_test ()
+{
+  // given:
+  int rows = 20;
+  int cols = 30;
+  lcg seed = 1904;
+  Laby lab;
+  /* the labyrinth with cycles, where closed rooms are not on one path */
+  laby_find_generator ("kruskal")->generate (&lab, rows, cols, &seed);
+  for (int r = 2; r < rows; r += 4)
+    for (int c = 0; c < cols; c++)
+      laby_rm_border (&lab, r, c, BOTTOM_BORDER);
+  Laby_Solver solver;
+  laby_solver_init (&solver, &lab);
+  int *dist = reference_distances (&lab, 5 * cols + 7);
+  laby_solve (&solver, rows - 1, cols - 1, 5, 7);
+
+  for (int i = 0; i < rows * cols; i++)
+    {
+      int r = i / cols, c = i % cols;
+      _Bool closed = laby_bfs_is_visited (&solver.bfs, r, c);
+      long touched = solver.bfs.touched_count;
+
+      // when:
+      long length = laby_solve (&solver, r, c, 5, 7);
+
+      // then:
+      mu_assert ("The path should be the shortest one", length == dist[i]);
+      if (closed)
+        mu_assert ("Closed rooms should be kept for the same target",
+                   solver.bfs.touched_count == touched);
+      long steps = 0;
+      while (laby_solver_next_room (&solver, &r, &c))
+        steps++;
+      mu_assert ("The path should end in the target",
+                 r == 5 && c == 7 && steps == length);
+    }
+  free (dist);
+  laby_solver_free (&solver);
+  laby_free (&lab);
+  return 0;
+}
@@ -0,0 +1,249 @@
+#include "laby_gen.h"
+#include "laby_stats.h"
+#include "minunit.h"
+
+/* reference_distances is in laby_helpers.h */
+
+/* Returns the room with the max distance */
+static int
+farthest_room (const Laby *lab, const int *dist)
+{
+  int far = 0;
+  for (int i = 0; i < lab->rows * lab->cols; i++)
+    if (dist[i] > dist[far])
+      far = i;
+  return far;
+}
+
+static int
+passages_count (const Laby *lab, int i)
+{
+  return 4 - __builtin_popcount (laby_get_borders (lab, i / lab->cols,
+                                                   i % lab->cols));
+}
+
+/* Counts corridors by the flood fill of rooms with two passages */
+static void
+count_corridors (const Laby *lab, long *corridors)
+{
+  int rows = lab->rows;
+  int cols = lab->cols;
+  char *reached = calloc (rows * cols, sizeof (char));
+  int *stack = malloc (sizeof (int) * rows * cols);
+  for (int k = 0; k < LABY_STATS_CORRIDORS; k++)
+    corridors[k] = 0;
+  for (int start = 0; start < rows * cols; start++)
+    {
+      if (reached[start] || passages_count (lab, start) != 2)
+        continue;
+      int top = 0;
+      long length = 0;
+      stack[top++] = start;
+      reached[start] = 1;
+      while (top > 0)
+        {
+          int i = stack[--top];
+          unsigned char borders = laby_get_borders (lab, i / cols, i % cols);
+          int next[4][2] = { { UPPER_BORDER, i - cols },
+                             { BOTTOM_BORDER, i + cols },
+                             { LEFT_BORDER, i - 1 },
+                             { RIGHT_BORDER, i + 1 } };
+          length++;
+          for (int j = 0; j < 4; j++)
+            if (!(borders & next[j][0]) && !reached[next[j][1]]
+                && passages_count (lab, next[j][1]) == 2)
+              {
+                reached[next[j][1]] = 1;
+                stack[top++] = next[j][1];
+              }
+        }
+      corridors[(length < LABY_STATS_CORRIDORS) ? length - 1
+                                                : LABY_STATS_CORRIDORS - 1]++;
+    }
+  free (reached);
+  free (stack);
+}
+
+static char *
+laby_stats_of_corridor_test ()
+{
+  // given:
+  Laby lab;
+  laby_init_empty (&lab, 1, 5);
+  laby_set_content (&lab, 0, 0, C_PLAYER);
+  laby_set_content (&lab, 0, 4, C_EXIT);
+  Laby_Stats stats;
+
+  // when:
+  laby_compute_stats (&lab, &stats);
+
+  // then:
+  mu_assert ("Both ends of the corridor should be dead ends",
+             stats.dead_ends == 2);
+  mu_assert ("The corridor should not have junctions", stats.junctions == 0);
+  mu_assert ("The middle of the corridor should be the corridor of 3 rooms",
+             stats.corridors[2] == 1);
+  mu_assert ("The diameter should be the length of the corridor",
+             stats.diameter == 4);
+  mu_assert ("The exit should be in 4 steps", stats.exit_distance == 4);
+  laby_free (&lab);
+  return 0;
+}
+
+static char *
+laby_stats_test ()
+{
+  int rows = 70;
+  int cols = 150;
+  const char *generators[] = { "eller", "backtracker", "kruskal" };
+  enum laby_layout layouts[] = { LL_ROWS, LL_TILES };
+  for (int g = 0; g < 3; g++)
+    for (int l = 0; l < 2; l++)
+      {
+        // given:
+        lcg seed = 1904;
+        Laby generated, lab;
+        laby_find_generator (generators[g])
+            ->generate (&generated, rows, cols, &seed);
+        laby_init (&lab, rows, cols, layouts[l]);
+        for (int r = 0; r < rows; r++)
+          for (int c = 0; c < cols; c++)
+            laby_add_border (&lab, r, c, laby_get_borders (&generated, r, c));
+        laby_set_content (&lab, 3, 140, C_PLAYER);
+        laby_set_content (&lab, 60, 7, C_EXIT);
+        Laby_Stats stats;
+
+        // when:
+        laby_compute_stats (&lab, &stats);
+
+        // then:
+        long dead_ends = 0, junctions = 0;
+        for (int i = 0; i < rows * cols; i++)
+          {
+            dead_ends += passages_count (&lab, i) == 1;
+            junctions += passages_count (&lab, i) >= 3;
+          }
+        mu_assert ("Wrong count of dead ends", stats.dead_ends == dead_ends);
+        mu_assert ("Wrong count of junctions", stats.junctions == junctions);
+
+        long corridors[LABY_STATS_CORRIDORS];
+        count_corridors (&lab, corridors);
+        for (int k = 0; k < LABY_STATS_CORRIDORS; k++)
+          mu_assert ("Wrong count of corridors",
+                     stats.corridors[k] == corridors[k]);
+
+        int *dist = reference_distances (&lab, 3 * cols + 140);
+        mu_assert ("Wrong distance to the exit",
+                   stats.exit_distance == dist[60 * cols + 7]);
+        free (dist);
+
+        /* two searches give the diameter only for perfect labyrinths */
+        if (g > 0)
+          {
+            dist = reference_distances (&lab, 0);
+            int *far
+                = reference_distances (&lab, farthest_room (&lab, dist));
+            mu_assert ("Wrong diameter",
+                       stats.diameter == far[farthest_room (&lab, far)]);
+            free (far);
+            free (dist);
+          }
+        laby_free (&generated);
+        laby_free (&lab);
+      }
+  return 0;
+}
+
+static char *
+laby_distance_percentile_test ()
+{
+  // given:
+  int rows = 50;
+  int cols = 130;
+  lcg seed = 1904;
+  Laby lab;
+  laby_find_generator ("backtracker")->generate (&lab, rows, cols, &seed);
+  int *dist = reference_distances (&lab, 20 * cols + 65);
+  int percentiles[] = { 0, 10, 50, 99, 100 };
+
+  for (int i = 0; i < 5; i++)
+    {
+      // when:
+      long d = laby_distance_percentile (&lab, 20, 65, percentiles[i]);
+
+      // then:
+      long closer = 0, not_farther = 0;
+      for (int j = 0; j < rows * cols; j++)
+        {
+          closer += dist[j] < d;
+          not_farther += dist[j] <= d;
+        }
+      mu_assert ("The distance should be enough to reach the percent of "
+                 "rooms",
+                 not_farther * 100 >= (long)rows * cols * percentiles[i]);
+      mu_assert ("The distance should be the least one",
+                 closer * 100 < (long)rows * cols * percentiles[i] || d == 0);
+    }
+  free (dist);
+  laby_free (&lab);
+  return 0;
+}
+
+static char *
+laby_choose_room_at_distance_test ()
+{
+  // given:
+  int rows = 50;
+  int cols = 130;
+  lcg seed = 1904;
+  Laby lab;
+  laby_find_generator ("kruskal")->generate (&lab, rows, cols, &seed);
+  int *dist = reference_distances (&lab, 7 * cols + 100);
+  int max = dist[farthest_room (&lab, dist)];
+  long steps[] = { 1, 10, 64, max, max + 100 };
+
+  for (int i = 0; i < 5; i++)
+    {
+      // when:
+      int r, c;
+      laby_choose_room_at_distance (&lab, 7, 100, steps[i], &seed, &r, &c);
+
+      // then:
+      mu_assert ("The room should be in the count of steps, or the farthest "
+                 "one",
+                 dist[r * cols + c] == ((steps[i] < max) ? steps[i] : max));
+    }
+  free (dist);
+  laby_free (&lab);
+  return 0;
+}
+
+static char *
+laby_choose_room_at_percentile_test ()
+{
+  // given:
+  int rows = 50;
+  int cols = 130;
+  lcg seed = 1904;
+  Laby lab;
+  laby_find_generator ("kruskal")->generate (&lab, rows, cols, &seed);
+  int percentiles[] = { 0, 10, 50, 99, 100 };
+
+  for (int i = 0; i < 5; i++)
+    {
+      // when:
+      lcg seed1 = 65537 + i, seed2 = 65537 + i;
+      int r, c, er, ec;
+      laby_choose_room_at_percentile (&lab, 7, 100, percentiles[i], 1,
+                                      &seed1, &r, &c);
+      long d = laby_distance_percentile (&lab, 7, 100, percentiles[i]);
+      laby_choose_room_at_distance (&lab, 7, 100, (d > 1) ? d : 1, &seed2,
+                                    &er, &ec);
+
+      // then:
+      mu_assert ("The room should be the same as by two searches",
+                 r == er && c == ec && seed1 == seed2);
+    }
+  laby_free (&lab);
+  return 0;
+}
@@ -0,0 +1,604 @@
+#include "laby.h"
+#include "minunit.h"
+#include <stdlib.h>
+#include <unistd.h>
+
+static char *
+laby_memory_footprint_test ()
+{
+  // given:
+  /* the footprint of the giant labyrinth is measured by laby_layouts_bench,
+   * the rows layout has the same count of bytes per room for any size */
+  int rows = 300;
+  int cols = 300;
+  Laby lab;
+
+  // when:
+  laby_init_empty (&lab, rows, cols);
+  laby_add_border (&lab, rows - 1, cols - 1, UPPER_BORDER);
+  laby_set_visibility (&lab, rows - 1, cols - 1, 1);
+  laby_set_content (&lab, rows - 1, cols - 1, C_EXIT);
+
+  // then:
+  mu_assert ("The small labyrinth should be kept in rows",
+             lab.layout == LL_ROWS);
+  mu_assert ("The labyrinth should take not more than one byte per room",
+             laby_memory_usage (&lab) <= (size_t)rows * cols);
+  mu_assert ("The border should be kept",
+             laby_get_borders (&lab, rows - 1, cols - 1) & UPPER_BORDER);
+  mu_assert ("The room should be visible",
+             laby_is_visible (&lab, rows - 1, cols - 1));
+  mu_assert ("The room should be known",
+             laby_is_known_room (&lab, rows - 1, cols - 1));
+  mu_assert ("The content should be kept",
+             laby_get_content (&lab, rows - 1, cols - 1) == C_EXIT);
+  laby_free (&lab);
+  return 0;
+}
+
+static char *
+laby_fill_rect_test ()
+{
+  // given:
+  Laby lab;
+  laby_init_empty (&lab, 3, 200);
+
+  // when:
+  laby_fill_rect (&lab, LP_KNOWN, 1, 60, 5, 70, 1);
+  laby_fill_rect (&lab, LP_KNOWN, 0, 0, 3, 64, 0);
+
+  // then:
+  mu_assert ("The rectangle should be cropped by the labyrinth",
+             laby_count_rect (&lab, LP_KNOWN, 0, 0, 3, 200) == 2 * 66);
+  mu_assert ("The rooms on the border of the word should be cleared",
+             !laby_is_known_room (&lab, 1, 63));
+  mu_assert ("The rooms after the border of the word should be set",
+             laby_is_known_room (&lab, 1, 64)
+                 && laby_is_known_room (&lab, 2, 129));
+  mu_assert ("The rooms out of the rectangle should not be set",
+             !laby_is_known_room (&lab, 0, 100)
+                 && !laby_is_known_room (&lab, 1, 130));
+  mu_assert ("Other planes should not be changed",
+             laby_count_rect (&lab, LP_VISIBLE, 0, 0, 3, 200) == 0);
+  laby_free (&lab);
+  return 0;
+}
+
+static char *
+laby_outer_borders_test ()
+{
+  // given:
+  Laby lab;
+  laby_init_empty (&lab, 2, 3);
+
+  // when:
+  laby_rm_border (&lab, 1, 2, RIGHT_BORDER | BOTTOM_BORDER);
+  laby_rm_border (&lab, 0, 0, LEFT_BORDER | UPPER_BORDER);
+  laby_fill_rect (&lab, LP_RIGHT, 0, 0, 2, 3, 0);
+
+  // then:
+  mu_assert ("The corner rooms should have outer borders",
+             laby_get_borders (&lab, 0, 0) == (LEFT_BORDER | UPPER_BORDER)
+                 && laby_get_borders (&lab, 1, 2)
+                        == (RIGHT_BORDER | BOTTOM_BORDER));
+  mu_assert ("The rooms above and below should have only one border",
+             laby_get_borders (&lab, -1, 1) == BOTTOM_BORDER
+                 && laby_get_borders (&lab, 2, 1) == UPPER_BORDER);
+  mu_assert ("The rooms on the left and right should have only one border",
+             laby_get_borders (&lab, 1, -1) == RIGHT_BORDER
+                 && laby_get_borders (&lab, 1, 3) == LEFT_BORDER);
+  mu_assert ("The rooms on the diagonals should not have borders",
+             laby_get_borders (&lab, -1, -1) == 0
+                 && laby_get_borders (&lab, 2, 3) == 0);
+  mu_assert ("The rooms around should not be visible",
+             !laby_is_visible (&lab, -1, 0)
+                 && !laby_is_known_room (&lab, 0, 3));
+  laby_free (&lab);
+  return 0;
+}
+
+static char *
+laby_tiles_layout_test ()
+{
+  enum laby_layout layouts[] = { LL_TILES, LL_BLOCKS, LL_MORTON };
+  for (int i = 0; i < sizeof (layouts) / sizeof (layouts[0]); i++)
+    {
+      // given:
+      int rows = 70;
+      int cols = 150;
+      lcg seed1 = 1904;
+      lcg seed2 = 1904;
+      Laby expected, actual;
+      laby_init (&expected, rows, cols, LL_ROWS);
+      laby_init (&actual, rows, cols, layouts[i]);
+
+      // when:
+      laby_generate_eller (&expected, &seed1);
+      laby_generate_eller (&actual, &seed2);
+      laby_mark_visible_rooms (&expected, 63, 63, 3);
+      laby_mark_visible_rooms (&actual, 63, 63, 3);
+
+      // then:
+      for (int r = -1; r <= rows; r++)
+        for (int c = -1; c <= cols; c++)
+          {
+            mu_assert ("Borders should be the same in both layouts",
+                       laby_get_borders (&expected, r, c)
+                           == laby_get_borders (&actual, r, c));
+            mu_assert ("Visibility should be the same in both layouts",
+                       laby_is_visible (&expected, r, c)
+                           == laby_is_visible (&actual, r, c));
+          }
+      mu_assert ("Known rooms should be counted in the tiles",
+                 laby_count_rect (&actual, LP_KNOWN, 0, 0, rows, cols)
+                     == laby_count_rect (&expected, LP_KNOWN, 0, 0, rows,
+                                         cols));
+      laby_free (&expected);
+      laby_free (&actual);
+    }
+  return 0;
+}
+
+static char *
+laby_giant_tiles_test ()
+{
+  // given:
+  int n = 1000000;
+  Laby lab;
+  laby_init_empty (&lab, n, n);
+  size_t initial_size = laby_memory_usage (&lab);
+
+  // when:
+  laby_add_border (&lab, n / 2, n / 2, UPPER_BORDER | RIGHT_BORDER);
+  laby_mark_visible_rooms (&lab, n - 1, n - 1, 2);
+
+  // then:
+  mu_assert ("The giant labyrinth should be kept in tiles",
+             lab.layout == LL_TILES);
+  mu_assert ("Only a few megabytes should be allocated at the beginning",
+             initial_size < 4 * 1024 * 1024);
+  /* one tile with borders, and the visible area on the edge of 4 tiles */
+  mu_assert ("Only changed tiles should be allocated",
+             lab.tiles_count == 5
+                 && laby_memory_usage (&lab) < initial_size + 128 * 1024);
+  mu_assert ("The corners should have outer borders",
+             laby_get_borders (&lab, 0, 0) == (LEFT_BORDER | UPPER_BORDER)
+                 && laby_get_borders (&lab, n - 1, 0)
+                        == (LEFT_BORDER | BOTTOM_BORDER)
+                 && laby_get_borders (&lab, 0, n - 1)
+                        == (RIGHT_BORDER | UPPER_BORDER));
+  mu_assert ("The rooms around should have only one border",
+             laby_get_borders (&lab, -1, n / 3) == BOTTOM_BORDER
+                 && laby_get_borders (&lab, n / 3, n) == LEFT_BORDER);
+  mu_assert ("The added borders should be kept",
+             laby_get_borders (&lab, n / 2, n / 2)
+                 == (UPPER_BORDER | RIGHT_BORDER));
+  mu_assert ("The rooms around the player should be visible",
+             laby_is_visible (&lab, n - 2, n - 2)
+                 && laby_count_rect (&lab, LP_VISIBLE, n - 10, n - 10, 10, 10)
+                        == 9);
+  laby_free (&lab);
+  return 0;
+}
+
+static char *
+laby_endless_ring_test ()
+{
+  // given:
+  int rows = 300;
+  int cols = 70;
+  lcg seed = 1904;
+  Laby expected, actual;
+  laby_generate (&expected, rows, cols, &seed);
+  laby_init (&actual, LABY_ENDLESS_ROWS, cols, LL_RING);
+  Laby_Eller eller;
+  laby_eller_init (&eller, cols, 1904, LEV_1);
+  laby_eller_next_row (&eller, &actual);
+  size_t initial_size = laby_memory_usage (&actual);
+
+  // when:
+  while (eller.row < rows - 1)
+    laby_eller_next_row (&eller, &actual);
+
+  // then:
+  mu_assert ("Only the last rows should be kept in the ring",
+             actual.ring_first == rows + 1 - LABY_RING_ROWS
+                 && laby_memory_usage (&actual) == initial_size);
+  for (int r = actual.ring_first; r < rows - 1; r++)
+    for (int c = -1; c <= cols; c++)
+      mu_assert ("Rows of the endless laby should be the same as rows of the "
+                 "regular laby with the same seed",
+                 laby_get_borders (&expected, r, c)
+                     == laby_get_borders (&actual, r, c));
+  laby_mark_whole_as_known (&actual);
+  mu_assert ("Only the rows in the ring should be marked",
+             laby_count_rect (&actual, LP_KNOWN, 0, 0, LABY_ENDLESS_ROWS, cols)
+                 == (long)cols * (LABY_RING_ROWS - 1));
+  laby_eller_free (&eller);
+  laby_free (&expected);
+  laby_free (&actual);
+  return 0;
+}
+
+static char *
+laby_file_test ()
+{
+  // given:
+  int rows = 70;
+  int cols = 150;
+  lcg seed = 1904;
+  Laby expected, actual;
+  laby_generate (&expected, rows, cols, &seed);
+  laby_mark_visible_rooms (&expected, 10, 10, 3);
+  char path[] = "/tmp/laby_file_test_XXXXXX";
+  close (mkstemp (path));
+
+  // when:
+  mu_assert ("The labyrinth should be saved",
+             laby_save_file (&expected, 1904, path) == 0);
+  lcg file_seed = 0;
+  mu_assert ("The labyrinth should be opened",
+             laby_open_file (&actual, &file_seed, path) == 0);
+
+  // then:
+  mu_assert ("The seed should be read from the file", file_seed == 1904);
+  mu_assert ("The size should be read from the file",
+             actual.rows == rows && actual.cols == cols);
+  for (int r = -1; r <= rows; r++)
+    for (int c = -1; c <= cols; c++)
+      {
+        mu_assert ("Borders should be the same as in the saved labyrinth",
+                   laby_get_borders (&expected, r, c)
+                       == laby_get_borders (&actual, r, c));
+        mu_assert ("Visibility should be the same as in the saved labyrinth",
+                   laby_is_visible (&expected, r, c)
+                       == laby_is_visible (&actual, r, c));
+      }
+  laby_mark_whole_as_known (&actual);
+  laby_free (&actual);
+  laby_open_file (&actual, NULL, path);
+  mu_assert ("Changes should not be written to the file",
+             laby_count_rect (&actual, LP_KNOWN, 0, 0, rows, cols)
+                 == laby_count_rect (&expected, LP_KNOWN, 0, 0, rows, cols));
+  laby_free (&actual);
+  laby_free (&expected);
+  unlink (path);
+  return 0;
+}
+
+/* Returns 1 when both files have the same bytes */
+static _Bool
+same_files (const char *path1, const char *path2)
+{
+  FILE *f1 = fopen (path1, "rb");
+  FILE *f2 = fopen (path2, "rb");
+  int c1, c2;
+  do
+    {
+      c1 = getc (f1);
+      c2 = getc (f2);
+    }
+  while (c1 == c2 && c1 != EOF);
+  fclose (f1);
+  fclose (f2);
+  return c1 == c2;
+}
+
+static char *
+laby_generate_file_test ()
+{
+  // given:
+  int rows = 200;
+  int cols = 150;
+  lcg seed = 1904;
+  Laby expected;
+  laby_generate (&expected, rows, cols, &seed);
+  char expected_path[] = "/tmp/laby_file_test_XXXXXX";
+  close (mkstemp (expected_path));
+  laby_save_file (&expected, 1904, expected_path);
+  char path[] = "/tmp/laby_file_test_XXXXXX";
+  close (mkstemp (path));
+
+  // when:
+  lcg file_seed = 1904;
+  mu_assert ("The labyrinth should be generated to the file",
+             laby_generate_file (rows, cols, &file_seed, path) == 0);
+
+  // then:
+  mu_assert ("The seed should be the same as after the generation",
+             file_seed == seed);
+  mu_assert ("The file should be the same as the saved labyrinth",
+             same_files (expected_path, path));
+  laby_free (&expected);
+  unlink (expected_path);
+  unlink (path);
+  return 0;
+}
+
+static char *
+laby_broken_file_test ()
+{
+  // given:
+  char path[] = "/tmp/laby_file_test_XXXXXX";
+  int fd = mkstemp (path);
+  write (fd, "LABY", 4);
+  close (fd);
+  Laby lab;
+
+  // then:
+  mu_assert ("The broken file should not be opened",
+             laby_open_file (&lab, NULL, path) == -1);
+  mu_assert ("The absent file should not be opened",
+             laby_open_file (&lab, NULL, "/tmp/absent/file") == -1);
+  unlink (path);
+  return 0;
+}
+
+static char *
+laby_stream_test ()
+{
+  // given:
+  int rows = 70;
+  int cols = 150;
+  lcg seed = 1904;
+  Laby expected, actual;
+  laby_generate (&expected, rows, cols, &seed);
+  laby_mark_visible_rooms (&expected, 10, 10, 3);
+  laby_fill_rect (&expected, LP_KNOWN, 30, 60, 20, 90, 1);
+  laby_mark_as_known_room (&expected, rows - 1, cols - 1);
+  laby_set_content (&expected, 10, 10, C_PLAYER);
+  laby_set_content (&expected, 12, 149, C_EXIT);
+  FILE *f = tmpfile ();
+
+  // when:
+  mu_assert ("The labyrinth should be written", laby_write (&expected, f) == 0);
+  long size = ftell (f);
+  rewind (f);
+  mu_assert ("The labyrinth should be read", laby_read (&actual, f) == 0);
+
+  // then:
+  mu_assert ("Only 2 bits per room should be used for borders",
+             size < rows * (cols + 63) / 64 * 16 + 64);
+  mu_assert ("The size should be read",
+             actual.rows == rows && actual.cols == cols);
+  for (int r = -1; r <= rows; r++)
+    for (int c = -1; c <= cols; c++)
+      {
+        mu_assert ("Borders should be the same as in the written labyrinth",
+                   laby_get_borders (&expected, r, c)
+                       == laby_get_borders (&actual, r, c));
+        mu_assert ("Known rooms should be the same as in the written "
+                   "labyrinth",
+                   laby_is_known_room (&expected, r, c)
+                       == laby_is_known_room (&actual, r, c));
+      }
+  mu_assert ("The content should be read",
+             laby_get_content (&actual, 10, 10) == C_PLAYER
+                 && laby_get_content (&actual, 12, 149) == C_EXIT
+                 && actual.content_count == 2);
+  mu_assert ("The visibility should not be written",
+             laby_count_rect (&actual, LP_VISIBLE, 0, 0, rows, cols) == 0);
+
+  Laby broken;
+  /* the content of the exit is the last byte of the stream */
+  fseek (f, -1, SEEK_END);
+  putc (C_HINT + 1, f);
+  rewind (f);
+  mu_assert ("The unknown content should not be read",
+             laby_read (&broken, f) == -1);
+  /* the exit in the row 12 + 2^32, which is 12 after the cut to int */
+  unsigned char far_exit[] = { 0x8c, 0x80, 0x80, 0x80, 0x10, 0x95, 0x01,
+                               C_EXIT };
+  fseek (f, -4, SEEK_END);
+  fwrite (far_exit, 1, sizeof (far_exit), f);
+  rewind (f);
+  mu_assert ("The content outside of the labyrinth should not be read",
+             laby_read (&broken, f) == -1);
+
+  rewind (f);
+  fputs ("garbage", f);
+  rewind (f);
+  mu_assert ("The broken stream should not be read",
+             laby_read (&actual, f) == -1);
+  fclose (f);
+  laby_free (&expected);
+  laby_free (&actual);
+  return 0;
+}
+
+/* Returns the count of passages between neighbor rooms */
+static long
+count_passages (const Laby *lab)
+{
+  long count = 0;
+  for (int r = 0; r < lab->rows; r++)
+    for (int c = 0; c < lab->cols; c++)
+      {
+        unsigned char borders = laby_get_borders (lab, r, c);
+        count += !(borders & RIGHT_BORDER) + !(borders & BOTTOM_BORDER);
+      }
+  return count;
+}
+
+static char *
+laby_wide_generation_test ()
+{
+  // given:
+  int rows = 50;
+  int cols = 1000;
+  lcg seed = 1904;
+  Laby lab;
+
+  // when:
+  laby_generate (&lab, rows, cols, &seed);
+
+  // then:
+  mu_assert ("All rooms of the wide labyrinth should be reachable",
+             count_reachable_rooms (&lab) == rows * cols);
+  laby_free (&lab);
+  return 0;
+}
+
+static char *
+laby_batch_generation_test ()
+{
+  // given:
+  int rows = 20;
+  int cols = 70;
+  lcg seeds[LABY_BATCH_LANES];
+  for (int k = 0; k < LABY_BATCH_LANES; k++)
+    seeds[k] = 1904 + k * 7919;
+  Laby_Batch batch;
+
+  // when:
+  laby_generate_batch (&batch, rows, cols, seeds);
+
+  // then:
+  for (int k = 0; k < LABY_BATCH_LANES; k++)
+    {
+      lcg seed = 1904 + k * 7919;
+      Laby expected, lab;
+      laby_generate (&expected, rows, cols, &seed);
+      laby_batch_unpack (&batch, k, &lab);
+      mu_assert ("The seed should be changed as by the scalar generator",
+                 seed == seeds[k]);
+      for (int r = 0; r < rows; r++)
+        for (int c = 0; c < cols; c++)
+          mu_assert ("Every labyrinth should be the same as the scalar one",
+                     laby_get_borders (&lab, r, c)
+                         == laby_get_borders (&expected, r, c));
+      laby_free (&expected);
+      laby_free (&lab);
+    }
+  laby_batch_free (&batch);
+  return 0;
+}
+
+static char *
+laby_chunks_generation_test ()
+{
+  // given:
+  const int side = LABY_CHUNK_SIDE;
+  const int n = 3;
+  lcg seed = 1904;
+  Laby chunks[3][3];
+  Laby whole;
+  laby_init (&whole, n * side, n * side, LL_ROWS);
+
+  // when:
+  /* the chunks around 0:0 are generated from the last one */
+  for (int i = n - 1; i >= 0; i--)
+    for (int j = n - 1; j >= 0; j--)
+      laby_generate_chunk (&chunks[i][j], seed, i - 1, j - 1);
+
+  // then:
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++)
+      for (int r = 0; r < side; r++)
+        for (int c = 0; c < side; c++)
+          {
+            unsigned char borders = laby_get_borders (&chunks[i][j], r, c);
+            if (c == 0 && j > 0)
+              mu_assert ("The left border should be the same as the right "
+                         "border of the neighbor chunk",
+                         !(borders & LEFT_BORDER)
+                             == !(laby_get_borders (&chunks[i][j - 1], r,
+                                                    side - 1)
+                                  & RIGHT_BORDER));
+            if (r == 0 && i > 0)
+              mu_assert ("The upper border should be the same as the bottom "
+                         "border of the neighbor chunk",
+                         !(borders & UPPER_BORDER)
+                             == !(laby_get_borders (&chunks[i - 1][j],
+                                                    side - 1, c)
+                                  & BOTTOM_BORDER));
+            laby_add_border (&whole, i * side + r, j * side + c,
+                             borders & (RIGHT_BORDER | BOTTOM_BORDER));
+          }
+  mu_assert ("All rooms of the joined chunks should be reachable",
+             count_reachable_rooms (&whole) == n * n * side * side);
+  /* 12 passages between 9 perfect chunks make 4 cycles */
+  mu_assert ("Every chunk should be perfect with a single passage through "
+             "every border",
+             count_passages (&whole) == n * n * side * side - 1 + 4);
+
+  Laby again;
+  laby_generate_chunk (&again, seed, 0, 0);
+  for (int r = 0; r < side; r++)
+    for (int c = 0; c < side; c++)
+      mu_assert ("The chunk should depend only on the seed and coordinates",
+                 laby_get_borders (&again, r, c)
+                     == laby_get_borders (&chunks[1][1], r, c));
+  laby_free (&again);
+  for (int i = 0; i < n; i++)
+    for (int j = 0; j < n; j++)
+      laby_free (&chunks[i][j]);
+  laby_free (&whole);
+  return 0;
+}
+
+static char *
+laby_parallel_generation_test ()
+{
+  int rows = 100;
+  int cols = 300;
+  int threads[] = { 1, 2, 4, 7 };
+  for (int i = 0; i < sizeof (threads) / sizeof (threads[0]); i++)
+    {
+      // given:
+      lcg seed1 = 1904;
+      lcg seed2 = 1904;
+      Laby lab, tiles;
+      laby_init (&lab, rows, cols, LL_ROWS);
+      laby_init (&tiles, rows, cols, LL_TILES);
+
+      // when:
+      laby_generate_parallel (&lab, &seed1, threads[i]);
+      laby_generate_parallel (&tiles, &seed2, threads[i]);
+
+      // then:
+      mu_assert ("All rooms should be reachable",
+                 count_reachable_rooms (&lab) == rows * cols);
+      mu_assert ("The labyrinth should not have cycles",
+                 count_passages (&lab) == rows * cols - 1);
+      for (int r = 0; r < rows; r++)
+        for (int c = 0; c < cols; c++)
+          mu_assert ("The labyrinth should depend only on the seed and the "
+                     "count of threads",
+                     laby_get_borders (&lab, r, c)
+                         == laby_get_borders (&tiles, r, c));
+      laby_free (&lab);
+      laby_free (&tiles);
+    }
+  return 0;
+}
+
+static char *
+laby_batched_generation_test ()
+{
+  // given:
+  int rows = 50;
+  int cols = 1000;
+  lcg seed1 = 1904;
+  lcg seed2 = 1904;
+  Laby lab1, lab2;
+  laby_init (&lab1, rows, cols, LL_ROWS);
+  laby_init (&lab2, rows, cols, LL_TILES);
+
+  // when:
+  laby_generate_eller_version (&lab1, &seed1, LEV_2);
+  laby_generate_eller_version (&lab2, &seed2, LEV_2);
+
+  // then:
+  mu_assert ("All rooms should be reachable",
+             count_reachable_rooms (&lab1) == rows * cols);
+  mu_assert ("The seed should be changed in the same way", seed1 == seed2);
+  for (int r = 0; r < rows; r++)
+    for (int c = 0; c < cols; c++)
+      mu_assert ("The same seed should give the same labyrinth",
+                 laby_get_borders (&lab1, r, c)
+                     == laby_get_borders (&lab2, r, c));
+  laby_free (&lab1);
+  laby_free (&lab2);
+  return 0;
+}
@@ -0,0 +1,65 @@
+#include "lcg.h"
+#include "minunit.h"
+
+static char *
+lcg_skip_test ()
+{
+  uint64_t steps[] = { 0, 1, 2, 1000, 123457 };
+  for (int i = 0; i < sizeof (steps) / sizeof (steps[0]); i++)
+    {
+      // given:
+      lcg expected = 1904;
+      lcg actual = 1904;
+
+      // when:
+      for (uint64_t j = 0; j < steps[i]; j++)
+        lcg_rand (&expected);
+      lcg_skip (&actual, steps[i]);
+
+      // then:
+      mu_assert ("Skip should give the same state as steps one by one",
+                 expected == actual);
+    }
+  return 0;
+}
+
+static char *
+lcg_skip_big_seed_test ()
+{
+  // given:
+  lcg expected = 0x123456789abcULL;
+  lcg actual = expected;
+
+  // when:
+  for (int j = 0; j < 10; j++)
+    lcg_rand (&expected);
+  lcg_skip (&actual, 10);
+
+  // then:
+  mu_assert ("The seed greater than the modulus should be skipped too",
+             expected == actual);
+  return 0;
+}
+
+static char *
+lcg_split_test ()
+{
+  // given:
+  lcg serial = 1904;
+  lcg seed = 1904;
+
+  // when:
+  lcg first = lcg_split (&seed, 100);
+  lcg second = lcg_split (&seed, 100);
+
+  // then:
+  for (int j = 0; j < 100; j++)
+    mu_assert ("The first stream should take the first numbers",
+               lcg_rand (&serial) == lcg_rand (&first));
+  for (int j = 0; j < 100; j++)
+    mu_assert ("The second stream should take the next numbers",
+               lcg_rand (&serial) == lcg_rand (&second));
+  mu_assert ("The seed should continue after the streams",
+             lcg_rand (&serial) == lcg_rand (&seed));
+  return 0;
+}
@@ -102,6 +102,35 @@ utf8_str_merge_2_test ()
   return 0;
 }
 
+static char *
+utf8_str_merge_shifted_appendix_test ()
+{
+  /* Here we check cases, when the appendix of the destination overlaps its
+   * new place after the merge */
+  const char *sources[] = { "███", "xyz" };
+  const char *dests[]
+      = { "!abcdefghijklmnopqrstuvwxyz", "!███abcdefghijklmnopqrstuvwxyz" };
+  const char *expected[]
+      = { "!███defghijklmnopqrstuvwxyz", "!xyzabcdefghijklmnopqrstuvwxyz" };
+  for (int i = 0; i < 2; i++)
+    {
+      // given:
+      u8str dest;
+      u8_str_init (&dest, dests[i], strlen (dests[i]));
+      u8str source;
+      u8_str_init (&source, sources[i], strlen (sources[i]));
+      // when:
+      u8_str_merge (&dest, &source, 1);
+      // then:
+      mu_u8str_eq_to_str (dest, expected[i]);
+      mu_assert ("Wrong length in the result",
+                 dest.length == strlen (expected[i]));
+      u8_str_free (&dest);
+      u8_str_free (&source);
+    }
+  return 0;
+}
+
 static char *
 utf8_merge_into_empty_str_test ()
 {
@@ -196,6 +225,29 @@ parse_string_to_buffer_test ()
   return 0;
 }
 
+static char *
+parse_many_strings_to_buffer_test ()
+{
+  /* The copy of the string should have the place for the terminating zero,
+   * otherwise the heap is broken by strings of every length */
+  char template[64];
+  for (int len = 1; len < sizeof (template); len++)
+    {
+      // given:
+      memset (template, 'x', len);
+      template[len] = '\0';
+      // when:
+      u8buf buf = U8_BUF_EMPTY;
+      u8_buffer_parse (&buf, template);
+      u8str res = u8_buffer_to_u8str (&buf);
+      // then:
+      mu_u8str_eq_to_str (res, template);
+      u8_str_free (&res);
+      u8_buffer_free (&buf);
+    }
+  return 0;
+}
+
 static char *
 merge_into_empty_buffers_test ()
 {
@@ -0,0 +1,258 @@
+/**
+ * The tool to look for seeds of difficult levels. It generates the first
+ * level of the game for every seed in the range on all cores, measures it,
+ * and prints the most difficult levels as CSV.
+ */
+#include "game.h"
+#include "laby.h"
+#include "lcg.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+/* The render is linked with the game, but is not used here. */
+int terminal_window_height = 0;
+int terminal_window_width = 0;
+
+static int laby_rows = 100;
+static int laby_cols = 100;
+static long first_seed = 1;
+static long seeds_count = 10000;
+static int top_count = 10;
+static int threads_count = 0;
+static long exit_distance = 0;
+static int exit_percentile = DEFAULT_EXIT_PERCENTILE;
+
+typedef struct
+{
+  long seed;
+  /* the count of steps from the player to the exit */
+  int path;
+  /* the count of rooms with a single passage */
+  int dead_ends;
+  /* the count of rooms with three or four passages */
+  int junctions;
+} Level_Metrics;
+
+/* The seeds checked by one thread and the best levels among them */
+typedef struct
+{
+  long first;
+  long step;
+  Level_Metrics *top;
+  int top_count;
+} Scan_Job;
+
+/* The level is more difficult when the path to the exit is longer */
+static int
+is_more_difficult (const Level_Metrics *a, const Level_Metrics *b)
+{
+  if (a->path != b->path)
+    return a->path > b->path;
+  if (a->dead_ends != b->dead_ends)
+    return a->dead_ends > b->dead_ends;
+  return a->seed < b->seed;
+}
+
+static int
+compare_levels (const void *a, const void *b)
+{
+  return is_more_difficult (b, a) - is_more_difficult (a, b);
+}
+
+/* Keeps the top sorted from the most difficult level */
+static void
+add_to_top (Level_Metrics *top, int *count, const Level_Metrics *m)
+{
+  int i = (*count < top_count) ? (*count)++ : top_count;
+  for (; i > 0 && is_more_difficult (m, &top[i - 1]); i--)
+    if (i < top_count)
+      top[i] = top[i - 1];
+  if (i < top_count)
+    top[i] = *m;
+}
+
+/* Returns the count of steps between the rooms by breadth-first search */
+static int
+path_length (const Laby *lab, int *dist, int *queue, int from, int to)
+{
+  int cols = lab->cols;
+  for (long i = 0; i < (long)lab->rows * cols; i++)
+    dist[i] = -1;
+  int head = 0, tail = 0;
+  queue[tail++] = from;
+  dist[from] = 0;
+  while (head < tail)
+    {
+      int i = queue[head++];
+      if (i == to)
+        return dist[i];
+      unsigned char borders = laby_get_borders (lab, i / cols, i % cols);
+      int next[4][2] = { { UPPER_BORDER, i - cols },
+                         { BOTTOM_BORDER, i + cols },
+                         { LEFT_BORDER, i - 1 },
+                         { RIGHT_BORDER, i + 1 } };
+      for (int j = 0; j < 4; j++)
+        if (!(borders & next[j][0]) && dist[next[j][1]] < 0)
+          {
+            dist[next[j][1]] = dist[i] + 1;
+            queue[tail++] = next[j][1];
+          }
+    }
+  return -1;
+}
+
+/* Generates the level as the game does, and measures it */
+static void
+measure_level (Level_Metrics *m, long seed, int *dist, int *queue)
+{
+  Laby lab;
+  Player player;
+  int exit_row, exit_col;
+  lcg s = seed;
+  laby_generate (&lab, laby_rows, laby_cols, &s);
+  game_choose_player_room (&lab, &s, &player);
+  game_choose_exit_room (&lab, &s, &player, exit_distance, exit_percentile,
+                         &exit_row, &exit_col);
+
+  m->seed = seed;
+  m->path = path_length (&lab, dist, queue,
+                         player.row * laby_cols + player.col,
+                         exit_row * laby_cols + exit_col);
+  m->dead_ends = 0;
+  m->junctions = 0;
+  for (int r = 0; r < laby_rows; r++)
+    for (int c = 0; c < laby_cols; c++)
+      {
+        int walls = __builtin_popcount (laby_get_borders (&lab, r, c));
+        m->dead_ends += walls == 3;
+        m->junctions += walls <= 1;
+      }
+  laby_free (&lab);
+}
+
+static void *
+scan_seeds (void *arg)
+{
+  Scan_Job *job = arg;
+  long rooms = (long)laby_rows * laby_cols;
+  int *dist = malloc (sizeof (int) * rooms);
+  int *queue = malloc (sizeof (int) * rooms);
+  for (long i = job->first; i < seeds_count; i += job->step)
+    {
+      Level_Metrics m;
+      measure_level (&m, first_seed + i, dist, queue);
+      add_to_top (job->top, &job->top_count, &m);
+    }
+  free (dist);
+  free (queue);
+  return NULL;
+}
+
+static int
+parse_args (int argc, char *argv[])
+{
+  int p;
+  while ((p = getopt (argc, argv, "h r: c: s: n: t: j: d: p:")) != -1)
+    {
+      switch (p)
+        {
+        case 'r':
+          laby_rows = strtol (optarg, NULL, 0);
+          break;
+        case 'c':
+          laby_cols = strtol (optarg, NULL, 0);
+          break;
+        case 's':
+          first_seed = strtol (optarg, NULL, 0);
+          break;
+        case 'n':
+          seeds_count = strtol (optarg, NULL, 0);
+          break;
+        case 't':
+          top_count = strtol (optarg, NULL, 0);
+          break;
+        case 'j':
+          threads_count = strtol (optarg, NULL, 0);
+          break;
+        case 'd':
+          exit_distance = strtol (optarg, NULL, 0);
+          break;
+        case 'p':
+          exit_percentile = strtol (optarg, NULL, 0);
+          break;
+        default:
+          fprintf (stderr,
+                   "Usage: seedscan [-r rows] [-c cols] [-s first seed] "
+                   "[-n seeds count] [-t top count] [-j threads] "
+                   "[-d exit distance] [-p exit percentile]\n");
+          return -1;
+        }
+    }
+  if (laby_rows < 2 || laby_cols < 2 || first_seed < 1 || seeds_count < 1
+      || top_count < 1 || exit_percentile < 0 || exit_percentile > 100)
+    {
+      fprintf (stderr, "The sizes, seeds and counts should be positive, "
+                       "the labyrinth should have at least 2x2 rooms.\n");
+      return -1;
+    }
+  return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+  if (parse_args (argc, argv) != 0)
+    return 1;
+  if (threads_count < 1)
+    threads_count = sysconf (_SC_NPROCESSORS_ONLN);
+  if (threads_count > seeds_count)
+    threads_count = seeds_count;
+
+  struct timespec start, end;
+  clock_gettime (CLOCK_MONOTONIC, &start);
+
+  Scan_Job *jobs = malloc (sizeof (Scan_Job) * threads_count);
+  pthread_t *ids = malloc (sizeof (pthread_t) * threads_count);
+  for (int i = 0; i < threads_count; i++)
+    {
+      jobs[i].first = i;
+      jobs[i].step = threads_count;
+      jobs[i].top = malloc (sizeof (Level_Metrics) * top_count);
+      jobs[i].top_count = 0;
+      pthread_create (&ids[i], NULL, scan_seeds, &jobs[i]);
+    }
+
+  /* merge the tops of all threads */
+  Level_Metrics *all = malloc (sizeof (Level_Metrics) * threads_count
+                               * top_count);
+  int count = 0;
+  for (int i = 0; i < threads_count; i++)
+    {
+      pthread_join (ids[i], NULL);
+      for (int j = 0; j < jobs[i].top_count; j++)
+        all[count++] = jobs[i].top[j];
+      free (jobs[i].top);
+    }
+  qsort (all, count, sizeof (Level_Metrics), compare_levels);
+
+  clock_gettime (CLOCK_MONOTONIC, &end);
+  double seconds
+      = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+  fprintf (stderr, "%ld seeds of %dx%d rooms on %d threads: %.2f s, "
+                   "%.1f millions of rooms per second\n",
+           seeds_count, laby_rows, laby_cols, threads_count, seconds,
+           seeds_count * laby_rows * laby_cols / seconds / 1e6);
+
+  printf ("seed,path,dead_ends,junctions\n");
+  for (int i = 0; i < count && i < top_count; i++)
+    printf ("%ld,%d,%d,%d\n", all[i].seed, all[i].path, all[i].dead_ends,
+            all[i].junctions);
+
+  free (all);
+  free (jobs);
+  free (ids);
+  return 0;
+}